@@ -0,0 +1,925 @@
+/*
+ * WC&DLI - Warcomeb Command & Debug Line Interface
+ * Copyright (C) 2020-2021 Marco Giammarini <http://www.warcomeb.it>
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*!
+ * \file  /tools/wcdli-bench.c
+ * \brief Host benchmarks of the hot paths of the library.
+ *
+ * The library is built into the benchmark with the POSIX host backend, so
+ * that the static functions can be measured alone. The output goes to
+ * /dev/null. Every case runs for at least the given time and prints one JSON
+ * object per line:
+ *
+ *   {"bench":"<group>","case":"<name>","iterations":N,"ns_per_op":T,...}
+ *
+ * Build:
+ *   cc -O2 -pthread -o wcdli-bench wcdli-bench.c
+ *
+ * Usage:
+ *   wcdli-bench [-t milliseconds-per-case]
+ *
+ * The feed cases store a pasted line by chunks, as an RX interrupt per byte
+ * or per FIFO drain, and give the interrupts per second at 921600 baud.
+ *
+ * The args cases convert the arguments of a command by hand with strtoul
+ * and strtof, and with a schema.
+ *
+ * The format cases print the same message into a buffer with the built-in
+ * formatter and with the C library vsnprintf.
+ *
+ * The flow cases paste faster than the console parses, without flow
+ * control and with XON/XOFF or RTS, and give the bytes lost every 1000.
+ *
+ * The frame cases split a pasted block of 4 KB into lines, with the old byte
+ * loop of WCDLI_ckeck() and with the framer.
+ *
+ * The transaction cases send the same request with its answer as a text
+ * line and as a packet of the binary mode.
+ *
+ * The log_queue cases stress the log queue with many producer threads and
+ * one consumer, and check that every record is delivered whole and in order
+ * or counted as lost.
+ */
+
+#define __POSIX_HOST
+#define __NO_PROFILES
+
+// Room to measure the lookup with a growing number of commands and apps
+#if !defined (WCDLI_MAX_EXTERNAL_COMMAND)
+#define WCDLI_MAX_EXTERNAL_COMMAND               96
+#endif
+#if !defined (WCDLI_MAX_EXTERNAL_APP)
+#define WCDLI_MAX_EXTERNAL_APP                   16
+#endif
+
+// Log messages of many threads go through the queue
+#if !defined (WCDLI_LOG_QUEUE_SLOTS)
+#define WCDLI_LOG_QUEUE_SLOTS                    256
+#endif
+
+#include "../wcdli.c"
+
+#include <sched.h>
+#include <time.h>
+
+static uint64_t mCaseTime = 200000000ull;
+static volatile uint32_t mSink = 0;
+
+typedef void (*Bench_Function_t)(void* obj, uint32_t iterations);
+
+static uint64_t now (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+/*!
+ * Run the function, doubling the iterations until the case lasts enough.
+ *
+ * \return The nanoseconds per iteration.
+ */
+static double run (Bench_Function_t function, void* obj, uint32_t* iterations)
+{
+    uint64_t start = 0, elapsed = 0;
+
+    *iterations = 16;
+    for (;;)
+    {
+        start = now();
+        function(obj,*iterations);
+        elapsed = now() - start;
+
+        if ((elapsed >= mCaseTime) || (*iterations >= 0x40000000u))
+        {
+            break;
+        }
+        *iterations *= 2;
+    }
+    return (double)elapsed / (double)*iterations;
+}
+
+static void report (const char* bench, const char* name, uint32_t iterations,
+                    double ns, const char* extraName, double extra)
+{
+    printf("{\"bench\":\"%s\",\"case\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.2f",
+           bench,name,(unsigned long)iterations,ns);
+    if (extraName != NULL)
+    {
+        printf(",\"%s\":%.0f",extraName,extra);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+static void emptyCallback (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+{
+    (void)app;
+    (void)argv;
+    mSink += argc;
+}
+
+/*!
+ * Copy a line into the current command, as WCDLI_ckeck() does.
+ */
+static void loadLine (const char* line)
+{
+    size_t length = strlen(line);
+
+    memcpy(WCDLI_mainContext->currentCommand,line,length + 1);
+    WCDLI_mainContext->currentCommandIndex = length;
+}
+
+/* ---------------------------------------------------------------- ingest */
+
+static const char* mStream[] =
+{
+    "cmd007 1 2 3\r\n",
+    "debug ?\r\n",
+    "app03 start \"hello world\" 100\r\n",
+    "cmd042 set speed 1500\r\n",
+    "version\r\n",
+    "unknown command\r\n",
+    "cmd09\b7 status\r\n",
+    "\r\n",
+};
+
+#define STREAM_SIZE                              (sizeof(mStream) / sizeof(mStream[0]))
+
+static void benchIngest (void* obj, uint32_t iterations)
+{
+    size_t* bytes = obj;
+
+    *bytes = 0;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        const char* line = mStream[i % STREAM_SIZE];
+
+        for (const char* c = line; *c != '\0'; ++c)
+        {
+            rxPush(WCDLI_mainContext,(uint8_t)*c);
+        }
+        *bytes += strlen(line);
+
+        while (WCDLI_isLineReady())
+        {
+            WCDLI_ckeck();
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- feed */
+
+/*!
+ * A pasted line: 10 bits per byte on the wire.
+ */
+#define FEED_BAUDRATE                            921600u
+
+static const char mPaste[] = "cmd000 set speed 1500 current 200 mode auto ramp 10 limit 3000\r\n";
+
+/*!
+ * Every call stores a chunk of the line, as an RX interrupt that drains the
+ * FIFO: a chunk of one byte is the interrupt per byte.
+ */
+static void benchFeed (void* obj, uint32_t iterations)
+{
+    size_t chunk = *(size_t*)obj;
+    size_t length = sizeof(mPaste) - 1;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (size_t offset = 0; offset < length; offset += chunk)
+        {
+            WCDLI_feed((const uint8_t*)&mPaste[offset],
+                       ((length - offset) < chunk) ? (length - offset) : chunk);
+        }
+
+        while (WCDLI_isLineReady())
+        {
+            WCDLI_ckeck();
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- flow */
+
+/*!
+ * A paste faster than the console: every call is an interrupt with a FIFO
+ * of bytes, sent only while the remote is not paused, and the console
+ * parses a line every eight interrupts.
+ */
+static void benchFlow (void* obj, uint32_t iterations)
+{
+    WCDLI_HostDevice_t* device = WCDLI_mainContext->device;
+    size_t length = sizeof(mPaste) - 1;
+    size_t offset = 0;
+    size_t chunk = 0;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        if (device->isRxReady == TRUE)
+        {
+            chunk = ((length - offset) < WCDLI_RX_CHUNK_DIMENSION) ? (length - offset) : WCDLI_RX_CHUNK_DIMENSION;
+            WCDLI_feed((const uint8_t*)&mPaste[offset],chunk);
+            offset = (offset + chunk) % length;
+        }
+
+        if ((i % 8) == 7)
+        {
+            WCDLI_ckeck();
+        }
+    }
+
+    while (WCDLI_wait(0))
+    {
+        WCDLI_ckeck();
+    }
+}
+
+/* ---------------------------------------------------------------- binary */
+
+static WCDLI_BinaryStatus_t binaryCallback (void* app, const uint8_t* request, uint16_t length,
+                                            uint8_t* response, uint16_t* responseLength)
+{
+    (void)app;
+    memcpy(response,request,length);
+    *responseLength = length;
+    return WCDLI_BINARYSTATUS_SUCCESS;
+}
+
+static void textCallback (void* app, int argc, const char* argv[])
+{
+    (void)app;
+    WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_NONE,"%s %s\r\n",argv[1],argv[2]);
+}
+
+static const WCDLI_Command_t mEcho = {"echo", "", NULL, NULL, textCallback, binaryCallback, NULL, NULL};
+
+static uint8_t mTransaction[WCDLI_MAX_CHARS_PER_LINE];
+static uint16_t mTransactionLength = 0;
+
+/*!
+ * The same request, as a line or as a packet, with its answer.
+ */
+static void benchTransaction (void* obj, uint32_t iterations)
+{
+    (void)obj;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        WCDLI_feed(mTransaction,mTransactionLength);
+        while (WCDLI_isLineReady())
+        {
+            WCDLI_ckeck();
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- frame */
+
+/*!
+ * A pasted configuration block, with some typing errors.
+ */
+static char mBurst[4096];
+static uint16_t mBurstLength = 0;
+
+static void buildBurst (void)
+{
+    int written = 0;
+
+    for (uint32_t i = 0; ; ++i)
+    {
+        written = snprintf(&mBurst[mBurstLength],sizeof(mBurst) - mBurstLength,
+                           (i % 8) == 7 ? "set motor.param%03lu x\b%lu\r\n" : "set motor.param%03lu %lu\r\n",
+                           (unsigned long)i,(unsigned long)(i * 37));
+        if ((written < 0) || ((size_t)written >= (sizeof(mBurst) - mBurstLength)))
+        {
+            break;
+        }
+        mBurstLength += written;
+    }
+}
+
+typedef bool (*Bench_Framer_t)(WCDLI_Context_t* ctx);
+
+/*!
+ * The framing of WCDLI_ckeck() before frameLine(): a byte at a time.
+ */
+static bool frameLineByByte (WCDLI_Context_t* ctx)
+{
+    char c = '\0';
+
+    while (ringCount(&ctx->rxRing) > 0)
+    {
+        c = ctx->rxRing.data[ctx->rxRing.tail];
+        ringSkip(&ctx->rxRing,1);
+
+        if (c == '\b')
+        {
+            if (ctx->currentCommandIndex > 0)
+            {
+                ctx->currentCommandIndex--;
+            }
+            continue;
+        }
+
+        if (ctx->currentCommandIndex == WCDLI_MAX_CHARS_PER_LINE)
+        {
+            ctx->currentCommand[WCDLI_MAX_CHARS_PER_LINE-2] = ctx->currentCommand[WCDLI_MAX_CHARS_PER_LINE-1];
+            ctx->currentCommandIndex = WCDLI_MAX_CHARS_PER_LINE-1;
+        }
+        ctx->currentCommand[ctx->currentCommandIndex++] = c;
+
+        if ((ctx->currentCommandIndex >= 2) &&
+            (ctx->currentCommand[ctx->currentCommandIndex-2] == '\r') &&
+            (ctx->currentCommand[ctx->currentCommandIndex-1] == '\n'))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * Frame the whole burst, a ring at a time, without dispatch.
+ */
+static void benchFrame (void* obj, uint32_t iterations)
+{
+    Bench_Framer_t framer = *(const Bench_Framer_t*)obj;
+    WCDLI_Context_t* ctx = WCDLI_mainContext;
+    uint16_t offset = 0;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        for (offset = 0; offset < mBurstLength; )
+        {
+            offset += ringWrite(&ctx->rxRing,(const uint8_t*)&mBurst[offset],mBurstLength - offset);
+            while (framer(ctx) == TRUE)
+            {
+                mSink += ctx->currentCommandIndex;
+                ctx->currentCommandIndex = 0;
+            }
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- lookup */
+
+static void benchLookup (void* obj, uint32_t iterations)
+{
+    WCDLI_Command_t command = {0};
+    bool changeMode = FALSE;
+    bool isAmbiguous = FALSE;
+
+    loadLine(obj);
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        parseCommand(WCDLI_mainContext,WCDLI_mainContext->currentCommand,&command,&changeMode,&isAmbiguous);
+        mSink += (command.name != NULL);
+    }
+}
+
+/* ---------------------------------------------------------------- params */
+
+static void benchParams (void* obj, uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        // The line is split in place, as in WCDLI_ckeck()
+        loadLine(obj);
+        char* end = &WCDLI_mainContext->currentCommand[WCDLI_mainContext->currentCommandIndex-2];
+        *end = '\0';
+        parseParams(WCDLI_mainContext,WCDLI_mainContext->currentCommand,end);
+        mSink += WCDLI_mainContext->numberOfParams;
+    }
+}
+
+/* ---------------------------------------------------------------- args */
+
+static const char mArgsLine[] = "set 1500 manual --ramp=2.5 --addr=0x1F\r\n";
+static const char* const mArgsModes[] = {"auto", "manual", NULL};
+static const WCDLI_ArgSchema_t mArgs[] =
+{
+    WCDLI_ARG_UINT("speed",0,0,3000),
+    WCDLI_ARG_ENUM("mode",WCDLI_ARGFLAG_OPTIONAL,mArgsModes),
+    WCDLI_ARG_FLOAT("ramp",WCDLI_ARGFLAG_OPTION,0,10),
+    WCDLI_ARG_HEX("addr",WCDLI_ARGFLAG_OPTION,0,0xFF),
+};
+static const WCDLI_CommandSchema_t mArgsSchema = {mArgs, 4, NULL};
+static const WCDLI_Command_t mArgsCommand = {"set", "", NULL, NULL, NULL, NULL, NULL, &mArgsSchema};
+
+/*!
+ * The same arguments checked by hand, with the C library parsers.
+ */
+static void benchArgsByHand (void* obj, uint32_t iterations)
+{
+    const char** argv = WCDLI_mainContext->params;
+    int argc = WCDLI_mainContext->numberOfParams;
+    char* end = NULL;
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        unsigned long speed = strtoul(argv[1],&end,10);
+        uint32_t mode = 0;
+        float ramp = 0;
+        unsigned long addr = 0;
+
+        if ((*end != '\0') || (speed > 3000))
+        {
+            continue;
+        }
+        for (int a = 2; a < argc; ++a)
+        {
+            if (strncmp(argv[a],"--ramp=",7) == 0)
+            {
+                ramp = strtof(&argv[a][7],&end);
+            }
+            else if (strncmp(argv[a],"--addr=",7) == 0)
+            {
+                addr = strtoul(&argv[a][7],&end,16);
+            }
+            else
+            {
+                for (mode = 0; (mArgsModes[mode] != NULL) && (strcmp(mArgsModes[mode],argv[a]) != 0); ++mode);
+            }
+        }
+        mSink += speed + mode + (uint32_t)ramp + addr;
+    }
+}
+
+static void benchArgsBySchema (void* obj, uint32_t iterations)
+{
+    WCDLI_ArgValue_t values[WCDLI_MAX_PARAMS];
+
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        if (parseSchema(WCDLI_mainContext,&mArgsCommand,values) == TRUE)
+        {
+            mSink += values[0].as.u + values[1].as.u + (uint32_t)values[2].as.f + values[3].as.u;
+        }
+    }
+}
+
+/* ----------------------------------------------------------------- format */
+
+#define FORMAT_MESSAGE \
+    "motor %s speed %5d rpm, current %u mA, addr 0x%04x, ramp %.2f" WCDLI_NEW_LINE
+
+static char mFormatBuffer[2 * WCDLI_MAX_CHARS_PER_LINE];
+
+static void benchFormatWcdli (void* obj, uint32_t iterations)
+{
+    (void)obj;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        formatString(mFormatBuffer,sizeof(mFormatBuffer),FORMAT_MESSAGE,
+                     "left",(int)i - 1000,i >> 3,i & 0xFFFFu,(double)i * 0.01);
+        mSink += (uint8_t)mFormatBuffer[20];
+    }
+}
+
+static void benchFormatLibc (void* obj, uint32_t iterations)
+{
+    (void)obj;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        snprintf(mFormatBuffer,sizeof(mFormatBuffer),FORMAT_MESSAGE,
+                 "left",(int)i - 1000,i >> 3,i & 0xFFFFu,(double)i * 0.01);
+        mSink += (uint8_t)mFormatBuffer[20];
+    }
+}
+
+/* ---------------------------------------------------------------- logging */
+
+/*!
+ * The consumer of the log queue, when the queue is used.
+ */
+static inline void drainLog (void)
+{
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    WCDLI_processLog(WCDLI_LOG_QUEUE_SLOTS);
+#endif
+}
+
+static void benchDebug (void* obj, uint32_t iterations)
+{
+    (void)obj;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        WCDLI_debug(WCDLI_MESSAGELEVEL_INFO,"motor started");
+        drainLog();
+    }
+}
+
+static void benchDebugByFormat (void* obj, uint32_t iterations)
+{
+    (void)obj;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_INFO,"speed %d rpm, current %d mA\r\n",i,i >> 3);
+        drainLog();
+    }
+}
+
+static void benchDebugFiltered (void* obj, uint32_t iterations)
+{
+    (void)obj;
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_DEBUG,"speed %d rpm, current %d mA\r\n",i,i >> 3);
+        drainLog();
+    }
+}
+
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+/* ---------------------------------------------------------------- log queue */
+
+#define LOG_QUEUE_MAX_PRODUCERS                  8
+
+typedef struct _Bench_Producer_t
+{
+    pthread_t thread;
+    uint32_t id;
+    uint32_t count;
+    bool isFormat;
+    uint64_t start;
+    uint64_t end;
+    uint64_t full;
+} Bench_Producer_t;
+
+static WCDLI_LogQueue_t mQueue;
+static pthread_barrier_t mStart;
+static volatile uint32_t mProducersDone = 0;
+
+/*!
+ * Every record carries its producer, its number and a check word: a torn or
+ * mixed record fails the check. The records are retried when the queue is
+ * full, so that all of them must be delivered. The debug calls cannot be
+ * retried: they wait for a free slot before the call, so the losses left
+ * are the races between the wait and the reservation, not the time the
+ * consumer thread is not scheduled.
+ */
+static void* producerThread (void* obj)
+{
+    Bench_Producer_t* producer = obj;
+    WCDLI_LogQueue_t* queue = NULL;
+    WCDLI_LogRecord_t* record = NULL;
+    uint32_t position = 0;
+
+    pthread_barrier_wait(&mStart);
+    producer->start = now();
+    for (uint32_t n = 0; n < producer->count; ++n)
+    {
+        if (producer->isFormat)
+        {
+            queue = &WCDLI_mainContext->logQueue;
+            while ((queue->head - __atomic_load_n(&queue->tail,__ATOMIC_ACQUIRE)) >= WCDLI_LOG_QUEUE_SLOTS)
+            {
+                producer->full++;
+                sched_yield();
+            }
+
+            // The whole path of a task: filter, format and queue
+            WCDLI_debugByFormat_ex(WCDLI_mainContext,WCDLI_MESSAGELEVEL_INFO,
+                                   "task %u message %u\r\n",producer->id,n);
+            continue;
+        }
+
+        while ((record = logReserve(&mQueue,&position)) == NULL)
+        {
+            producer->full++;
+            sched_yield();
+        }
+        record->level = WCDLI_MESSAGELEVEL_INFO;
+        record->length = snprintf(record->text,sizeof(record->text),"%u %u %u",
+                                  producer->id,n,n ^ (producer->id * 0x9E3779B9u));
+        logCommit(record,position);
+    }
+    producer->end = now();
+    __atomic_add_fetch(&mProducersDone,1,__ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*!
+ * Check the records of the queue while the producers run.
+ *
+ * \return The number of records with errors.
+ */
+static uint32_t consumeRecords (uint32_t producers, uint64_t* delivered)
+{
+    int64_t last[LOG_QUEUE_MAX_PRODUCERS];
+    WCDLI_LogRecord_t* record = NULL;
+    unsigned id = 0, n = 0, check = 0;
+    uint32_t errors = 0;
+    bool isDone = FALSE;
+
+    for (uint32_t i = 0; i < LOG_QUEUE_MAX_PRODUCERS; ++i)
+    {
+        last[i] = -1;
+    }
+
+    while (!isDone)
+    {
+        // Read the flag first: the records committed before it are drained
+        isDone = (__atomic_load_n(&mProducersDone,__ATOMIC_ACQUIRE) == producers);
+        while ((record = logPeek(&mQueue)) != NULL)
+        {
+            record->text[record->length] = '\0';
+            if ((sscanf(record->text,"%u %u %u",&id,&n,&check) != 3) ||
+                (id >= producers) ||
+                (check != (n ^ (id * 0x9E3779B9u))) ||
+                ((int64_t)n != (last[id] + 1)))
+            {
+                errors++;
+            }
+            else
+            {
+                last[id] = n;
+            }
+            (*delivered)++;
+            logRelease(&mQueue,record);
+        }
+        sched_yield();
+    }
+    return errors;
+}
+
+/*!
+ * \return The number of records with errors.
+ */
+static uint32_t benchLogQueue (uint32_t producers, bool isFormat, uint32_t count)
+{
+    Bench_Producer_t producer[LOG_QUEUE_MAX_PRODUCERS] = {0};
+    uint64_t produced = (uint64_t)producers * count;
+    uint64_t delivered = 0;
+    uint64_t busy = 0;
+    uint64_t full = 0;
+    uint64_t start = UINT64_MAX;
+    uint64_t end = 0;
+    uint32_t errors = 0;
+    char name[WCDLI_BUFFER_SIZE];
+
+    logInit(&mQueue);
+    logInit(&WCDLI_mainContext->logQueue);
+    mProducersDone = 0;
+    pthread_barrier_init(&mStart,NULL,producers + 1);
+    for (uint32_t i = 0; i < producers; ++i)
+    {
+        producer[i].id = i;
+        producer[i].count = count;
+        producer[i].isFormat = isFormat;
+        pthread_create(&producer[i].thread,NULL,producerThread,&producer[i]);
+    }
+
+    pthread_barrier_wait(&mStart);
+    if (isFormat)
+    {
+        while (__atomic_load_n(&mProducersDone,__ATOMIC_ACQUIRE) != producers)
+        {
+            delivered += WCDLI_processLog(WCDLI_LOG_QUEUE_SLOTS);
+            sched_yield();
+        }
+        delivered += WCDLI_processLog(WCDLI_LOG_QUEUE_SLOTS);
+    }
+    else
+    {
+        errors = consumeRecords(producers,&delivered);
+        if (delivered != produced)
+        {
+            errors++;
+        }
+    }
+
+    for (uint32_t i = 0; i < producers; ++i)
+    {
+        pthread_join(producer[i].thread,NULL);
+        start = (producer[i].start < start) ? producer[i].start : start;
+        end = (producer[i].end > end) ? producer[i].end : end;
+        busy += producer[i].end - producer[i].start;
+        full += producer[i].full;
+    }
+    pthread_barrier_destroy(&mStart);
+
+    // Cost per message seen by a producer, and throughput of all of them
+    snprintf(name,sizeof(name),"%s/producers%u",isFormat ? "debug_by_format" : "records",producers);
+    printf("{\"bench\":\"log_queue\",\"case\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,"
+           "\"messages_per_sec\":%.0f,\"delivered\":%llu,\"lost\":%llu,\"full\":%llu,\"errors\":%lu}\n",
+           name,(unsigned long long)produced,(double)busy / (double)produced,
+           ((double)produced * 1e9) / (double)(end - start),(unsigned long long)delivered,
+           (unsigned long long)(produced - delivered),(unsigned long long)full,(unsigned long)errors);
+    fflush(stdout);
+    return errors;
+}
+#endif
+
+int main (int argc, char* argv[])
+{
+    WCDLI_HostDevice_t device = {0};
+    uint32_t iterations = 0;
+    double ns = 0;
+    char name[WCDLI_BUFFER_SIZE];
+    uint16_t registered = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((strcmp(argv[i],"-t") == 0) && ((i + 1) < argc))
+        {
+            mCaseTime = strtoull(argv[++i],NULL,0) * 1000000ull;
+        }
+        else
+        {
+            fprintf(stderr,"usage: %s [-t milliseconds-per-case]\n",argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Null sink: the cost of the output is the cost of the library only
+    device.rx   = -1;
+    device.tx   = open("/dev/null",O_WRONLY);
+    device.peer = -1;
+    if (device.tx < 0)
+    {
+        perror("/dev/null");
+        return EXIT_FAILURE;
+    }
+    WCDLI_init(&device);
+
+    // Lookup cost as the registered names grow: commands and apps share the
+    // prefix, as they usually do
+    static const uint16_t steps[] = {0, 8, 32, WCDLI_MAX_EXTERNAL_COMMAND};
+    static char names[WCDLI_MAX_EXTERNAL_COMMAND + WCDLI_MAX_EXTERNAL_APP][8];
+    for (uint8_t s = 0; s < (sizeof(steps) / sizeof(steps[0])); ++s)
+    {
+        for (; registered < steps[s]; ++registered)
+        {
+            sprintf(names[registered],"cmd%03u",registered);
+            WCDLI_addCommandByParam(names[registered],"",emptyCallback);
+            if ((registered % (WCDLI_MAX_EXTERNAL_COMMAND / WCDLI_MAX_EXTERNAL_APP)) == 0)
+            {
+                char* app = names[WCDLI_MAX_EXTERNAL_COMMAND + (registered / (WCDLI_MAX_EXTERNAL_COMMAND / WCDLI_MAX_EXTERNAL_APP))];
+                sprintf(app,"app%02u",registered / (WCDLI_MAX_EXTERNAL_COMMAND / WCDLI_MAX_EXTERNAL_APP));
+                WCDLI_addAppByParam(app,"",NULL,emptyCallback);
+            }
+        }
+
+        const char* lines[][2] =
+        {
+            {"static"   , "version 1 2\r\n"},
+            {"external" , (registered > 0) ? names[registered - 1] : "cmd000"},
+            {"miss"     , "cmd999 1 2\r\n"},
+        };
+        for (uint8_t l = 0; l < (sizeof(lines) / sizeof(lines[0])); ++l)
+        {
+            char line[WCDLI_MAX_CHARS_PER_LINE];
+            snprintf(line,sizeof(line),"%s%s",lines[l][1],(l == 1) ? " 1 2\r\n" : "");
+            ns = run(benchLookup,line,&iterations);
+            snprintf(name,sizeof(name),"%s/%u",lines[l][0],registered + mExternalAppsIndex);
+            report("parse_command",name,iterations,ns,"registered",registered + mExternalAppsIndex);
+        }
+    }
+
+    // Tokenizer cost against the number of arguments and the quoting
+    const char* params[][2] =
+    {
+        {"args0"       , "status\r\n"},
+        {"args3"       , "set speed 1500\r\n"},
+        {"args8"       , "a b c d e f g h\r\n"},
+        {"spaces"      , "set    speed     1500\r\n"},
+        {"quoted"      , "say \"hello world\" \"and more\"\r\n"},
+        {"long_quoted" , "say \"the quick brown fox jumps over the lazy dog\"\r\n"},
+    };
+    for (uint8_t p = 0; p < (sizeof(params) / sizeof(params[0])); ++p)
+    {
+        ns = run(benchParams,(void*)params[p][1],&iterations);
+        report("parse_params",params[p][0],iterations,ns,"bytes",strlen(params[p][1]));
+    }
+
+    // Whole line ingest, dispatch included
+    size_t bytes = 0;
+    ns = run(benchIngest,&bytes,&iterations);
+    report("ckeck","mixed_stream",iterations,ns,"bytes_per_sec",
+           ((double)bytes * 1e9) / (ns * (double)iterations));
+
+    // Transactions of the text shell and of the binary mode
+    WCDLI_addCommand((WCDLI_Command_t*)&mEcho);
+    mTransactionLength = sprintf((char*)mTransaction,"echo 1500 200\r\n");
+    ns = run(benchTransaction,NULL,&iterations);
+    report("transaction","text",iterations,ns,"transactions_per_sec",1e9 / ns);
+
+    uint8_t packet[8];
+    uint16_t id = 0;
+    uint16_t crc = 0;
+    WCDLI_getCommandId("echo",&id);
+    packet[0] = (uint8_t)id;
+    packet[1] = (uint8_t)(id >> 8);
+    packet[2] = 1500 & 0xFF;
+    packet[3] = 1500 >> 8;
+    packet[4] = 200;
+    packet[5] = 0;
+    crc = crc16(packet,6);
+    packet[6] = (uint8_t)crc;
+    packet[7] = (uint8_t)(crc >> 8);
+    mTransactionLength = cobsEncode(packet,sizeof(packet),mTransaction);
+    WCDLI_mainContext->operativeMode = WCDLI_OPERATIVEMODE_BINARY;
+    ns = run(benchTransaction,NULL,&iterations);
+    report("transaction","binary",iterations,ns,"transactions_per_sec",1e9 / ns);
+    WCDLI_mainContext->operativeMode = WCDLI_OPERATIVEMODE_COMMAND;
+
+    // Framing of a pasted block, old byte loop against the framer
+    static const Bench_Framer_t framers[] = {frameLineByByte, frameLine};
+    static const char* framerNames[] = {"byte_loop", "memchr"};
+    buildBurst();
+    for (uint8_t f = 0; f < (sizeof(framers) / sizeof(framers[0])); ++f)
+    {
+        ns = run(benchFrame,(void*)&framers[f],&iterations);
+        report("frame",framerNames[f],iterations,ns,"bytes_per_sec",((double)mBurstLength * 1e9) / ns);
+    }
+
+    // Ingest of a paste by chunks: the calls are the interrupts at the
+    // emulated baud rate, dispatch included
+    static const size_t chunks[] = {1, WCDLI_RX_CHUNK_DIMENSION, sizeof(mPaste) - 1};
+    for (uint8_t c = 0; c < (sizeof(chunks) / sizeof(chunks[0])); ++c)
+    {
+        size_t chunk = chunks[c];
+
+        ns = run(benchFeed,&chunk,&iterations);
+        snprintf(name,sizeof(name),"chunk%u",(unsigned)chunk);
+        report("feed",name,iterations,ns,"interrupts_per_sec",
+               (FEED_BAUDRATE / 10.0) / (double)chunk);
+    }
+
+    // A paste faster than the parser, with and without flow control: the
+    // lost bytes are counted every 1000 received
+    static const WCDLI_FlowControl_t flows[] = {WCDLI_FLOWCONTROL_NONE, WCDLI_FLOWCONTROL_XONXOFF, WCDLI_FLOWCONTROL_RTS};
+    static const char* flowNames[] = {"none", "xonxoff", "rts"};
+    for (uint8_t f = 0; f < (sizeof(flows) / sizeof(flows[0])); ++f)
+    {
+        WCDLI_setFlowControl(flows[f]);
+        WCDLI_resetCounters();
+        ns = run(benchFlow,NULL,&iterations);
+        report("flow",flowNames[f],iterations,ns,"lost_per_1000",
+               (WCDLI_getCounters()->rxOverruns * 1000.0) / WCDLI_getCounters()->rxBytes);
+    }
+    WCDLI_setFlowControl(WCDLI_FLOWCONTROL_NONE);
+
+    // Conversion of the arguments of a split line
+    loadLine(mArgsLine);
+    char* argsEnd = &WCDLI_mainContext->currentCommand[WCDLI_mainContext->currentCommandIndex-2];
+    *argsEnd = '\0';
+    parseParams(WCDLI_mainContext,WCDLI_mainContext->currentCommand,argsEnd);
+    ns = run(benchArgsByHand,NULL,&iterations);
+    report("args","by_hand",iterations,ns,NULL,0);
+    ns = run(benchArgsBySchema,NULL,&iterations);
+    report("args","schema",iterations,ns,NULL,0);
+
+    // A message with every kind of conversion
+    ns = run(benchFormatWcdli,NULL,&iterations);
+    report("format","wcdli",iterations,ns,"calls_per_sec",1e9 / ns);
+    ns = run(benchFormatLibc,NULL,&iterations);
+    report("format","libc",iterations,ns,"calls_per_sec",1e9 / ns);
+
+    // Logging: messages are printed in debug mode only
+    WCDLI_mainContext->operativeMode = WCDLI_OPERATIVEMODE_DEBUG;
+    WCDLI_debugLevel = WCDLI_MESSAGELEVEL_INFO;
+    ns = run(benchDebug,NULL,&iterations);
+    report("log","debug",iterations,ns,"calls_per_sec",1e9 / ns);
+    ns = run(benchDebugByFormat,NULL,&iterations);
+    report("log","debug_by_format",iterations,ns,"calls_per_sec",1e9 / ns);
+    ns = run(benchDebugFiltered,NULL,&iterations);
+    report("log","debug_filtered",iterations,ns,"calls_per_sec",1e9 / ns);
+
+    uint32_t errors = 0;
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    // Scaling of the log queue with the number of producers
+    for (uint32_t producers = 1; producers <= LOG_QUEUE_MAX_PRODUCERS; producers *= 2)
+    {
+        errors += benchLogQueue(producers,FALSE,(uint32_t)(mCaseTime / 1000u));
+        errors += benchLogQueue(producers,TRUE,(uint32_t)(mCaseTime / 1000u));
+    }
+#endif
+
+    WCDLI_flush();
+    return ((errors > 0) || (mSink == 0xFFFFFFFFu)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
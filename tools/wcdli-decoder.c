@@ -0,0 +1,374 @@
+/*
+ * WC&DLI - Warcomeb Command & Debug Line Interface
+ * Copyright (C) 2020-2021 Marco Giammarini <http://www.warcomeb.it>
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*!
+ * \file  /tools/wcdli-decoder.c
+ * \brief Host decoder of the deferred messages.
+ *
+ * The decoder reads the stream captured from the serial line, prints the
+ * text as it is and formats the binary records of the deferred messages.
+ * The format strings are read from the raw firmware image (for example the
+ * output of objcopy -O binary) loaded at the given address.
+ *
+ * Build:
+ *   cc -I.. -o wcdli-decoder wcdli-decoder.c
+ *
+ * Usage:
+ *   wcdli-decoder [-i image.bin -a load-address] [capture]
+ */
+
+#define __NO_PROFILES
+#include "wcdli-types.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t* mImage = NULL;
+static size_t mImageSize = 0;
+static uint64_t mImageAddress = 0;
+
+static const char* mLevels[] =
+{
+    "", "[FAT]: ", "[ERR]: ", "[WAR]: ", "[INF]: ", "[DBG]: ", "", "",
+};
+
+static uint64_t readWord (FILE* in, uint8_t size, int* isEof)
+{
+    uint64_t word = 0;
+    int c = 0;
+
+    for (uint8_t i = 0; i < size; ++i)
+    {
+        c = fgetc(in);
+        if (c == EOF)
+        {
+            *isEof = 1;
+            return 0;
+        }
+        word |= ((uint64_t)c) << (8 * i);
+    }
+    return word;
+}
+
+/*!
+ * \return The format string into the image, NULL when out of the image.
+ */
+static const char* getFormat (uint64_t id)
+{
+    if ((mImage == NULL) || (id < mImageAddress) || (id >= (mImageAddress + mImageSize)))
+    {
+        return NULL;
+    }
+
+    const char* format = (const char*)&mImage[id - mImageAddress];
+    if (memchr(format,'\0',mImageSize - (id - mImageAddress)) == NULL)
+    {
+        return NULL;
+    }
+    return format;
+}
+
+/*!
+ * \return The next word of the record, zero past its arguments as on the
+ *         device.
+ */
+static uint32_t nextWord (const uint32_t* args, uint8_t* next)
+{
+    return (*next < 8) ? args[(*next)++] : 0;
+}
+
+/*!
+ * Print the format of the image with the words of the record. The format is
+ * not trusted: every conversion is rebuilt, with the values of '*' written
+ * into it, and printed with an explicit cast of its word. The conversions
+ * that would read the memory of the host (%s, %p, %n) or a 64 bit argument
+ * are printed as raw words.
+ */
+static void printFormat (const char* format, const uint32_t* args)
+{
+    char spec[48];
+    const char* start = NULL;
+    size_t length = 0;
+    uint32_t word = 0;
+    int32_t star = 0;
+    uint8_t next = 0;
+    int bits = 32;
+
+    while (*format != '\0')
+    {
+        if (*format != '%')
+        {
+            putchar(*format++);
+            continue;
+        }
+        if (format[1] == '%')
+        {
+            putchar('%');
+            format += 2;
+            continue;
+        }
+
+        // Flags, width and precision, at most 999 each
+        start = format++;
+        spec[0] = '%';
+        length = 1;
+        while ((*format != '\0') && (strchr("-+ #0123456789.*",*format) != NULL) &&
+               (length < (sizeof(spec) - 8)))
+        {
+            if (*format != '*')
+            {
+                spec[length++] = *format++;
+                continue;
+            }
+
+            star = (int32_t)nextWord(args,&next);
+            star = (star > 999) ? 999 : (star < -999) ? -999 : star;
+            if ((spec[length-1] == '.') && (star < 0))
+            {
+                // A negative precision is omitted
+                length--;
+            }
+            else
+            {
+                length += (size_t)snprintf(&spec[length],8,"%d",(int)star);
+            }
+            format++;
+        }
+
+        // The length modifiers of the device, where int and long are 32 bit
+        bits = 32;
+        if (strncmp(format,"hh",2) == 0)
+        {
+            bits = 8;
+            format += 2;
+        }
+        else if ((strncmp(format,"ll",2) == 0) || (*format == 'j') || (*format == 'L'))
+        {
+            bits = 64;
+            format += (*format == 'l') ? 2 : 1;
+        }
+        else if (*format == 'h')
+        {
+            bits = 16;
+            format++;
+        }
+        else if ((*format == 'l') || (*format == 'z') || (*format == 't'))
+        {
+            format++;
+        }
+
+        if (*format == '\0')
+        {
+            break;
+        }
+        word = nextWord(args,&next);
+
+        if ((bits == 64) || (strchr("diuoxXc",*format) == NULL))
+        {
+            printf("<%.*s 0x%08lx>",(int)(format - start + 1),start,(unsigned long)word);
+        }
+        else if (*format == 'c')
+        {
+            strcpy(&spec[length],"c");
+            printf(spec,(int)(uint8_t)word);
+        }
+        else if ((*format == 'd') || (*format == 'i'))
+        {
+            strcpy(&spec[length],"ld");
+            printf(spec,(bits == 8)  ? (long)(int8_t)word  :
+                        (bits == 16) ? (long)(int16_t)word : (long)(int32_t)word);
+        }
+        else
+        {
+            spec[length]   = 'l';
+            spec[length+1] = *format;
+            spec[length+2] = '\0';
+            printf(spec,(bits == 8)  ? (unsigned long)(uint8_t)word  :
+                        (bits == 16) ? (unsigned long)(uint16_t)word : (unsigned long)word);
+        }
+        format++;
+    }
+}
+
+static void printRecord (uint8_t header, uint64_t id, uint32_t timestamp,
+                         const uint32_t* args, uint8_t argc)
+{
+    const char* format = getFormat(id);
+
+    if ((header & WCDLI_DEFERRED_HEADER_LEVEL_MASK) == WCDLI_DEFERRED_HEADER_LOST)
+    {
+        printf("[%10lu] %s%lu deferred messages lost\n",(unsigned long)timestamp,
+               mLevels[WCDLI_MESSAGELEVEL_WARNING],(unsigned long)args[0]);
+        return;
+    }
+
+    printf("[%10lu] %s",(unsigned long)timestamp,
+           mLevels[header & WCDLI_DEFERRED_HEADER_LEVEL_MASK]);
+
+    if (format != NULL)
+    {
+        printFormat(format,args);
+    }
+    else
+    {
+        printf("<format 0x%08llx>",(unsigned long long)id);
+        for (uint8_t i = 0; i < argc; ++i)
+        {
+            printf(" 0x%08lx",(unsigned long)args[i]);
+        }
+        printf("\n");
+    }
+}
+
+static int decode (FILE* in)
+{
+    uint32_t args[8] = {0};
+    uint64_t id = 0;
+    uint32_t timestamp = 0;
+    uint8_t argc = 0;
+    int isEof = 0;
+    int header = 0;
+    int c = 0;
+
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (c != WCDLI_DEFERRED_SYNC_0)
+        {
+            putchar(c);
+            continue;
+        }
+
+        c = fgetc(in);
+        if (c != WCDLI_DEFERRED_SYNC_1)
+        {
+            putchar(WCDLI_DEFERRED_SYNC_0);
+            if (c == EOF)
+            {
+                break;
+            }
+            ungetc(c,in);
+            continue;
+        }
+
+        header = fgetc(in);
+        if (header == EOF)
+        {
+            break;
+        }
+        argc = (header & WCDLI_DEFERRED_HEADER_ARGC_MASK) >> WCDLI_DEFERRED_HEADER_ARGC_SHIFT;
+        if (argc > 8)
+        {
+            fprintf(stderr,"wcdli-decoder: wrong record header 0x%02x\n",header);
+            continue;
+        }
+
+        id = readWord(in,(header & WCDLI_DEFERRED_HEADER_WIDE_ID) ? 8 : 4,&isEof);
+        timestamp = (uint32_t)readWord(in,4,&isEof);
+        memset(args,0,sizeof(args));
+        for (uint8_t i = 0; i < argc; ++i)
+        {
+            args[i] = (uint32_t)readWord(in,4,&isEof);
+        }
+        if (isEof)
+        {
+            fprintf(stderr,"wcdli-decoder: truncated record\n");
+            break;
+        }
+
+        printRecord((uint8_t)header,id,timestamp,args,argc);
+    }
+    return 0;
+}
+
+static int loadImage (const char* path)
+{
+    FILE* file = fopen(path,"rb");
+    long size = 0;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fseek(file,0,SEEK_END);
+    size = ftell(file);
+    fseek(file,0,SEEK_SET);
+
+    // One more byte: the last string is always terminated
+    mImage = calloc(size + 1,1);
+    if ((mImage == NULL) || (fread(mImage,1,size,file) != (size_t)size))
+    {
+        fclose(file);
+        return -1;
+    }
+    mImageSize = size + 1;
+    fclose(file);
+    return 0;
+}
+
+int main (int argc, char* argv[])
+{
+    FILE* in = stdin;
+    const char* image = NULL;
+    int i = 1;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if ((strcmp(argv[i],"-i") == 0) && ((i + 1) < argc))
+        {
+            image = argv[++i];
+        }
+        else if ((strcmp(argv[i],"-a") == 0) && ((i + 1) < argc))
+        {
+            mImageAddress = strtoull(argv[++i],NULL,0);
+        }
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr,"usage: %s [-i image.bin -a load-address] [capture]\n",argv[0]);
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            in = fopen(argv[i],"rb");
+            if (in == NULL)
+            {
+                perror(argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if ((image != NULL) && (loadImage(image) != 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    decode(in);
+    return EXIT_SUCCESS;
+}
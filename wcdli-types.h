@@ -47,6 +47,9 @@ extern "C"
 #include "firmware.h"
 #endif
 
+#include <stdbool.h>
+#include <stdint.h>
+
 /*!
  * \defgroup WCDLI_Types WCDLI Types
  * \ingroup  WCDLI
@@ -68,7 +71,7 @@ static const Utility_Version_t WCDLI_FIRMWARE_VERSION =
 #endif
 
 #if !defined _weak
-#if defined (__NUECLIPSE)
+#if defined (__NUECLIPSE) || defined (__POSIX_HOST)
 #define _weak __attribute__((weak))
 #else
 #define _weak __WEAK
@@ -95,6 +98,8 @@ typedef enum _WCDLI_Errors_t
     WCDLI_ERROR_ADD_COMMAND_FAIL   = 0x0200,
     WCDLI_ERROR_ADD_APP_FAIL       = 0x0201,
     WCDLI_ERROR_EMPTY_CALLBACK     = 0x0202,
+    WCDLI_ERROR_DUPLICATED_NAME    = 0x0203,
+    WCDLI_ERROR_ADD_MODULE_FAIL    = 0x0204,
 
 } WCDLI_Error_t;
 
@@ -112,6 +117,15 @@ typedef enum _WCDLI_MessageLevel_t
     WCDLI_MESSAGELEVEL_ALL     = 6,
 } WCDLI_MessageLevel_t;
 
+/*!
+ * Identifier of a module with its own debug level.
+ */
+typedef uint8_t WCDLI_Module_t;
+
+#if !defined (WCDLI_MAX_MODULES)
+#define WCDLI_MAX_MODULES                        8
+#endif
+
 /*!
  * Device operative mode.
  */
@@ -119,19 +133,461 @@ typedef enum _WCDLI_OperativeMode_t
 {
     WCDLI_OPERATIVEMODE_DEBUG   = 0,
     WCDLI_OPERATIVEMODE_COMMAND = 1,
+    WCDLI_OPERATIVEMODE_BINARY  = 2,
 } WCDLI_OperativeMode_t;
 
+/*!
+ * Status of the response of the binary mode.
+ */
+typedef enum _WCDLI_BinaryStatus_t
+{
+    WCDLI_BINARYSTATUS_SUCCESS       = 0x00,
+    WCDLI_BINARYSTATUS_NOT_FOUND     = 0x01, /*!< No command with the ID */
+    WCDLI_BINARYSTATUS_NOT_SUPPORTED = 0x02, /*!< The command has no binary callback */
+    WCDLI_BINARYSTATUS_WRONG_PARAMS  = 0x03,
+    WCDLI_BINARYSTATUS_WRONG_FRAME   = 0x04, /*!< Wrong encoding, length or CRC */
+    WCDLI_BINARYSTATUS_FAIL          = 0x05,
+} WCDLI_BinaryStatus_t;
+
+/*!
+ * Binary mode: every packet is COBS encoded and ended by a zero byte. The
+ * decoded request is made of the command ID, the argument payload and the
+ * CRC-16/CCITT-FALSE of ID and payload. The response repeats the ID, then
+ * the status byte, the result payload and the CRC. ID and CRC are 2 bytes,
+ * little endian.
+ *
+ * The command ID is the position into its table: the static commands start
+ * from 0x0000, the external commands from WCDLI_BINARY_ID_COMMANDS and the
+ * apps from WCDLI_BINARY_ID_APPS.
+ */
+#define WCDLI_BINARY_DELIMITER                   0x00u
+#define WCDLI_BINARY_ID_COMMANDS                 0x4000u
+#define WCDLI_BINARY_ID_APPS                     0x8000u
+#define WCDLI_BINARY_ID_ERROR                    0xFFFEu /*!< Response to a wrong frame */
+#define WCDLI_BINARY_ID_EXIT                     0xFFFFu /*!< Back to the command mode */
+
+/*!
+ * Max number of bytes of the result payload of a binary command.
+ */
+#if !defined (WCDLI_BINARY_MAX_RESPONSE)
+#define WCDLI_BINARY_MAX_RESPONSE                64
+#endif
+
+/*!
+ * What to do when the TX ring has no room for a message. An interrupt
+ * handler, or a caller with the interrupts masked, never waits: there the
+ * blocking policy drops the newest bytes.
+ */
+typedef enum _WCDLI_TxOverflowPolicy_t
+{
+    WCDLI_TXOVERFLOW_DROP_NEWEST = 0,
+    WCDLI_TXOVERFLOW_DROP_OLDEST = 1,
+    WCDLI_TXOVERFLOW_BLOCK       = 2,
+} WCDLI_TxOverflowPolicy_t;
+
+/*!
+ * Dimension of the TX ring, zero means blocking writes without ring.
+ */
+#if !defined (WCDLI_TX_BUFFER_DIMENSION)
+#define WCDLI_TX_BUFFER_DIMENSION                0
+#endif
+
+#if !defined (WCDLI_TX_OVERFLOW_POLICY)
+#define WCDLI_TX_OVERFLOW_POLICY                 WCDLI_TXOVERFLOW_BLOCK
+#endif
+
+/*!
+ * When the staged output is handed to the transport.
+ */
+typedef enum _WCDLI_OutputFlushPolicy_t
+{
+    WCDLI_OUTPUTFLUSH_ON_NEW_LINE  = 0,
+    WCDLI_OUTPUTFLUSH_ON_THRESHOLD = 1,
+    WCDLI_OUTPUTFLUSH_EXPLICIT     = 2,
+} WCDLI_OutputFlushPolicy_t;
+
+#if !defined (WCDLI_OUTPUT_FLUSH_POLICY)
+#define WCDLI_OUTPUT_FLUSH_POLICY                WCDLI_OUTPUTFLUSH_ON_NEW_LINE
+#endif
+
+/*!
+ * Where the deferred messages go.
+ */
+typedef enum _WCDLI_DeferredOutput_t
+{
+    WCDLI_DEFERRED_OUTPUT_FORMAT = 0, /*!< Formatted on the device in idle time */
+    WCDLI_DEFERRED_OUTPUT_BINARY = 1, /*!< Sent as binary records to the host decoder */
+} WCDLI_DeferredOutput_t;
+
+/*!
+ * Dimension of the ring of the deferred messages, zero means no deferred
+ * messages.
+ */
+#if !defined (WCDLI_DEFERRED_BUFFER_DIMENSION)
+#define WCDLI_DEFERRED_BUFFER_DIMENSION          0
+#endif
+
+#if !defined (WCDLI_DEFERRED_OUTPUT)
+#define WCDLI_DEFERRED_OUTPUT                    WCDLI_DEFERRED_OUTPUT_FORMAT
+#endif
+
+/*!
+ * Max number of argument words of a deferred message.
+ */
+#if !defined (WCDLI_DEFERRED_MAX_ARGS)
+#define WCDLI_DEFERRED_MAX_ARGS                  8
+#endif
+
+#if (WCDLI_DEFERRED_MAX_ARGS > 8)
+#error "WCDLI: a deferred message has at most 8 arguments."
+#endif
+
+/*!
+ * Binary record of a deferred message, little endian:
+ * sync bytes, header byte, format string address (4 bytes, 8 bytes with
+ * WCDLI_DEFERRED_HEADER_WIDE_ID), timestamp (4 bytes), argument words
+ * (4 bytes each).
+ */
+#define WCDLI_DEFERRED_SYNC_0                    0xA5u
+#define WCDLI_DEFERRED_SYNC_1                    0x5Au
+#define WCDLI_DEFERRED_HEADER_LEVEL_MASK         0x07u
+#define WCDLI_DEFERRED_HEADER_ARGC_MASK          0x78u
+#define WCDLI_DEFERRED_HEADER_ARGC_SHIFT         3
+#define WCDLI_DEFERRED_HEADER_WIDE_ID            0x80u
+
+/*!
+ * Level of the record that reports the lost messages: its format address is
+ * zero and its only argument is the number of messages lost.
+ */
+#define WCDLI_DEFERRED_HEADER_LOST               0x07u
+
 #if !defined (WCDLI_BUFFER_SIZE)
 #define WCDLI_BUFFER_SIZE                        80
 #endif
 
+#if !defined (WCDLI_MAX_CHARS_PER_LINE)
+#define WCDLI_MAX_CHARS_PER_LINE                 80
+#endif
+
+#if !defined (WCDLI_MAX_PARAMS)
+#define WCDLI_MAX_PARAMS                         10
+#endif
+
 /*!
- *
+ * When 1, the formatter of the messages prints %f with fixed-point digits.
+ * With 0 no floating point code is linked, and %f is printed as it is.
+ */
+#if !defined (WCDLI_FORMAT_FLOAT)
+#define WCDLI_FORMAT_FLOAT                       1
+#endif
+
+/*!
+ * Dimension of the buffer of the incoming bytes.
+ */
+#if !defined (WCDLI_BUFFER_DIMENSION)
+#define WCDLI_BUFFER_DIMENSION                   0x00FFu
+#endif
+
+/*!
+ * Dimension of the staging buffer of the output.
+ */
+#if !defined (WCDLI_OUTPUT_BUFFER_DIMENSION)
+#define WCDLI_OUTPUT_BUFFER_DIMENSION            128
+#endif
+
+#if !defined (WCDLI_DEFAULT_OPERATIVE_MODE)
+#define WCDLI_DEFAULT_OPERATIVE_MODE             WCDLI_OPERATIVEMODE_COMMAND
+#endif
+
+/*!
+ * How the remote is asked to pause when the RX ring fills up.
+ */
+typedef enum _WCDLI_FlowControl_t
+{
+    WCDLI_FLOWCONTROL_NONE    = 0,
+    WCDLI_FLOWCONTROL_XONXOFF = 1,            /*!< XOFF and XON bytes, in command and debug mode only */
+    WCDLI_FLOWCONTROL_RTS     = 2,            /*!< The RTS line, driven by WCDLI_setRxFlow() */
+} WCDLI_FlowControl_t;
+
+#if !defined (WCDLI_FLOW_CONTROL)
+#define WCDLI_FLOW_CONTROL                       WCDLI_FLOWCONTROL_NONE
+#endif
+
+#define WCDLI_XON                                0x11
+#define WCDLI_XOFF                               0x13
+
+/*!
+ * The remote is paused when the RX ring holds WCDLI_RX_HIGH_WATERMARK bytes,
+ * and restarted when it holds WCDLI_RX_LOW_WATERMARK bytes or only a part of
+ * a line. The room over the high watermark takes the bytes sent before the
+ * remote stops.
+ */
+#if !defined (WCDLI_RX_HIGH_WATERMARK)
+#define WCDLI_RX_HIGH_WATERMARK                  ((WCDLI_BUFFER_DIMENSION * 3) / 4)
+#endif
+
+#if !defined (WCDLI_RX_LOW_WATERMARK)
+#define WCDLI_RX_LOW_WATERMARK                   (WCDLI_BUFFER_DIMENSION / 4)
+#endif
+
+#if (WCDLI_RX_LOW_WATERMARK >= WCDLI_RX_HIGH_WATERMARK) || (WCDLI_RX_HIGH_WATERMARK > WCDLI_BUFFER_DIMENSION)
+#error "WCDLI: the RX low watermark must be lower than the high one, and the high one fit the ring."
+#endif
+
+/*!
+ * Byte ring with one producer and one consumer: the producer moves only the
+ * head and the consumer moves only the tail. One slot is always left empty.
+ */
+typedef struct _WCDLI_Ring_t
+{
+    uint8_t* data;
+    uint16_t size;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+} WCDLI_Ring_t;
+
+/*!
+ * Number of slots of the log queue, a power of two: the log messages of the
+ * tasks and of the interrupts are queued whole and printed by the console.
+ * Zero means the messages are written by the caller.
+ */
+#if !defined (WCDLI_LOG_QUEUE_SLOTS)
+#define WCDLI_LOG_QUEUE_SLOTS                    0
+#endif
+
+/*!
+ * When 1, every log message carries the time of the event, taken from
+ * WCDLI_getTimestamp() when the message is written or queued. A message
+ * prints the delta from the previous one of the console as "+<delta>", and
+ * the absolute time as "@<time>" on the first message and every
+ * WCDLI_LOG_TIMESTAMP_SYNC messages.
+ */
+#if !defined (WCDLI_LOG_TIMESTAMP)
+#define WCDLI_LOG_TIMESTAMP                      0
+#endif
+
+#if !defined (WCDLI_LOG_TIMESTAMP_SYNC)
+#define WCDLI_LOG_TIMESTAMP_SYNC                 64
+#endif
+
+#if ((WCDLI_LOG_QUEUE_SLOTS & (WCDLI_LOG_QUEUE_SLOTS - 1)) != 0)
+#error "WCDLI: the slots of the log queue must be a power of two."
+#endif
+
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+/*!
+ * A message of the log queue. The sequence tells the owner of the slot: it
+ * is equal to the position when the slot is free, to the position plus one
+ * when the message is committed.
+ */
+typedef struct _WCDLI_LogRecord_t
+{
+    volatile uint32_t sequence;
+    uint8_t level;
+    uint16_t length;
+#if (WCDLI_LOG_TIMESTAMP > 0)
+    uint32_t timestamp;
+#endif
+    char text[WCDLI_MAX_CHARS_PER_LINE];
+} WCDLI_LogRecord_t;
+
+/*!
+ * Bounded queue with many producers and one consumer: the producers reserve
+ * a slot moving the head with a compare and swap, the consumer moves only
+ * the tail.
+ */
+typedef struct _WCDLI_LogQueue_t
+{
+    WCDLI_LogRecord_t records[WCDLI_LOG_QUEUE_SLOTS];
+    volatile uint32_t head;
+    uint32_t tail;
+    volatile uint32_t lost;
+} WCDLI_LogQueue_t;
+#endif
+
+/*!
+ * The health counters of a console. The RX counters are written by the RX
+ * interrupt only, the others by the console only: a plain increment is
+ * enough. The truncated log lines queued by many interrupts can be
+ * undercounted.
+ */
+typedef struct _WCDLI_Counters_t
+{
+    volatile uint32_t rxBytes;
+    volatile uint32_t rxOverruns;             /*!< Bytes lost with the RX ring full */
+    volatile uint16_t rxHighWater;            /*!< Max bytes waiting into the RX ring */
+    volatile uint32_t rxPauses;               /*!< Remote paused by the flow control */
+    uint32_t txBytes;
+    uint64_t txBlockedCycles;                 /*!< Time waiting the TX, in units of WCDLI_getCycles() */
+    uint32_t lines;                           /*!< Lines and packets parsed */
+    uint32_t unknownCommands;                 /*!< Commands not found or ambiguous */
+    uint32_t truncatedLogs;                   /*!< Queued messages cut at WCDLI_MAX_CHARS_PER_LINE */
+} WCDLI_Counters_t;
+
+/*!
+ * When 1, the duration of every command is measured and the command "stats"
+ * prints the table. With 0 no code and no memory are added.
+ */
+#if !defined (WCDLI_PROFILING)
+#define WCDLI_PROFILING                          0
+#endif
+
+#if (WCDLI_PROFILING > 0)
+/*!
+ * The durations of a command, in units of WCDLI_getCycles().
+ */
+typedef struct _WCDLI_CommandStats_t
+{
+    uint32_t calls;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} WCDLI_CommandStats_t;
+#endif
+
+/*!
+ * Callback with every argument copied into a row of WCDLI_BUFFER_SIZE chars.
+ * The copy is made on the stack of WCDLI_ckeck() at every call: it costs
+ * WCDLI_MAX_PARAMS * WCDLI_BUFFER_SIZE bytes of stack (800 bytes with the
+ * defaults) and a copy of the arguments. New commands should use
+ * WCDLI_CommandArgvCallback_t, which has neither cost.
  */
 typedef void (*WCDLI_CommandCallback_t)(void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
 
 /*!
+ * Callback with the arguments pointing into the line buffer: they are valid
+ * until the callback returns.
+ */
+typedef void (*WCDLI_CommandArgvCallback_t)(void* app, int argc, const char* argv[]);
+
+/*!
+ * Callback of the binary mode, with the argument payload pointing into the
+ * line buffer.
+ *
+ * \param[in]          app:
+ * \param[in]      request: The argument payload.
+ * \param[in]       length: The bytes of the argument payload.
+ * \param[out]    response: The result payload.
+ * \param[in,out] responseLength: The room of response, then the bytes written.
+ * \return The status of the response.
+ */
+typedef WCDLI_BinaryStatus_t (*WCDLI_CommandBinaryCallback_t)(void* app,
+                                                              const uint8_t* request,
+                                                              uint16_t length,
+                                                              uint8_t* response,
+                                                              uint16_t* responseLength);
+
+/*!
+ * The return code of a resumable command.
+ */
+typedef enum _WCDLI_CommandState_t
+{
+    WCDLI_COMMANDSTATE_DONE    = 0,
+    WCDLI_COMMANDSTATE_RUNNING = 1,           /*!< Call again at the next WCDLI_ckeck() */
+} WCDLI_CommandState_t;
+
+/*!
+ * The state kept by a resumable command between two calls.
+ */
+typedef struct _WCDLI_CommandRun_t
+{
+    uint32_t step;                            /*!< 0 at the first call, then owned by the command */
+    bool isCancelled;                         /*!< Ctrl-C received: last call, to clean up */
+} WCDLI_CommandRun_t;
+
+/*!
+ * The callback of a command that can yield: it is called again at every
+ * WCDLI_ckeck() while it returns WCDLI_COMMANDSTATE_RUNNING. The arguments
+ * stay valid up to the end of the run.
  *
+ * \param[in]      app: The app of the command.
+ * \param[in]     argc: The number of arguments, the command included.
+ * \param[in]     argv: The arguments.
+ * \param[in,out]  run: The state of the run.
+ * \return WCDLI_COMMANDSTATE_RUNNING to be called again,
+ *         WCDLI_COMMANDSTATE_DONE when the command ends.
+ */
+typedef WCDLI_CommandState_t (*WCDLI_CommandResumableCallback_t)(void* app,
+                                                                 int argc,
+                                                                 const char* argv[],
+                                                                 WCDLI_CommandRun_t* run);
+
+/*!
+ * The type of an argument of a command schema.
+ */
+typedef enum _WCDLI_ArgType_t
+{
+    WCDLI_ARGTYPE_INT    = 0,                 /*!< Signed decimal, 32 bits */
+    WCDLI_ARGTYPE_UINT   = 1,                 /*!< Unsigned decimal, 32 bits */
+    WCDLI_ARGTYPE_HEX    = 2,                 /*!< Unsigned hexadecimal, with or without 0x */
+    WCDLI_ARGTYPE_FLOAT  = 3,                 /*!< Fixed point notation, as -12.5 */
+    WCDLI_ARGTYPE_ENUM   = 4,                 /*!< One of the values, as its index */
+    WCDLI_ARGTYPE_STRING = 5,
+} WCDLI_ArgType_t;
+
+#define WCDLI_ARGFLAG_OPTIONAL                   0x01 /*!< A positional argument that can be missing */
+#define WCDLI_ARGFLAG_OPTION                     0x02 /*!< Given as --name=value, it can be missing */
+
+/*!
+ * An argument of a command schema.
+ */
+typedef struct _WCDLI_ArgSchema_t
+{
+    const char* name;                         /*!< Printed by the usage, the key of an option */
+    WCDLI_ArgType_t type;
+    uint8_t flags;
+    int64_t min;                              /*!< The range of a number, not checked when equal to max */
+    int64_t max;
+    const char* const* values;                /*!< The values of an enum, NULL terminated */
+} WCDLI_ArgSchema_t;
+
+#define WCDLI_ARG_INT(NAME,FLAGS,MIN,MAX)        {NAME, WCDLI_ARGTYPE_INT, FLAGS, MIN, MAX, NULL}
+#define WCDLI_ARG_UINT(NAME,FLAGS,MIN,MAX)       {NAME, WCDLI_ARGTYPE_UINT, FLAGS, MIN, MAX, NULL}
+#define WCDLI_ARG_HEX(NAME,FLAGS,MIN,MAX)        {NAME, WCDLI_ARGTYPE_HEX, FLAGS, MIN, MAX, NULL}
+#define WCDLI_ARG_FLOAT(NAME,FLAGS,MIN,MAX)      {NAME, WCDLI_ARGTYPE_FLOAT, FLAGS, MIN, MAX, NULL}
+#define WCDLI_ARG_ENUM(NAME,FLAGS,VALUES)        {NAME, WCDLI_ARGTYPE_ENUM, FLAGS, 0, 0, VALUES}
+#define WCDLI_ARG_STRING(NAME,FLAGS)             {NAME, WCDLI_ARGTYPE_STRING, FLAGS, 0, 0, NULL}
+
+/*!
+ * The value of a parsed argument.
+ */
+typedef struct _WCDLI_ArgValue_t
+{
+    union
+    {
+        int32_t i;                            /*!< WCDLI_ARGTYPE_INT */
+        uint32_t u;                           /*!< WCDLI_ARGTYPE_UINT, WCDLI_ARGTYPE_HEX, WCDLI_ARGTYPE_ENUM */
+        float f;                              /*!< WCDLI_ARGTYPE_FLOAT */
+        const char* s;                        /*!< WCDLI_ARGTYPE_STRING */
+    } as;
+    bool isSet;                               /*!< FALSE for a missing optional argument */
+} WCDLI_ArgValue_t;
+
+/*!
+ * The callback of a command with a schema: the arguments are parsed and
+ * checked before the call, and a wrong line prints the usage.
+ *
+ * \param[in]  app: The app of the command.
+ * \param[in] argc: The number of arguments of the schema.
+ * \param[in] argv: The values, in the order of the schema.
+ */
+typedef void (*WCDLI_CommandTypedCallback_t)(void* app, uint8_t argc, const WCDLI_ArgValue_t argv[]);
+
+/*!
+ * The arguments of a command: the positional ones in order, then the
+ * options in any position.
+ */
+typedef struct _WCDLI_CommandSchema_t
+{
+    const WCDLI_ArgSchema_t* args;
+    uint8_t count;
+    WCDLI_CommandTypedCallback_t callback;
+} WCDLI_CommandSchema_t;
+
+/*!
+ * A command is called with resumableCallback when it is not NULL, then with
+ * the callback of its schema, then with argvCallback, then with callback.
+ * In binary mode it is called with binaryCallback.
  */
 typedef struct _WCDLI_Command_t
 {
@@ -139,12 +595,25 @@ typedef struct _WCDLI_Command_t
     const char *description;
     void *device;
     WCDLI_CommandCallback_t callback;
+    WCDLI_CommandArgvCallback_t argvCallback;
+    WCDLI_CommandBinaryCallback_t binaryCallback;
+    WCDLI_CommandResumableCallback_t resumableCallback;
+    const WCDLI_CommandSchema_t* schema;
 } WCDLI_Command_t;
 
 #if !defined (WCDLI_DEBUG_MESSAGE_LEVEL)
 #define WCDLI_DEBUG_MESSAGE_LEVEL                WCDLI_MESSAGELEVEL_ALL
 #endif
 
+/*!
+ * Messages with a level greater than this value are removed at compile time,
+ * arguments included. It must be a number, from 0 (NONE) to 6 (ALL), because
+ * it is used by the preprocessor.
+ */
+#if !defined (WCDLI_COMPILE_MESSAGE_LEVEL)
+#define WCDLI_COMPILE_MESSAGE_LEVEL              6
+#endif
+
 /*!
  * \}
  */
@@ -24,8 +24,13 @@
  * THE SOFTWARE.
  */
 
+#if defined (__POSIX_HOST) && !defined (_XOPEN_SOURCE)
+// Needed by the pseudo-terminal functions
+#define _XOPEN_SOURCE                            700
+#define _DEFAULT_SOURCE
+#endif
+
 #include "wcdli.h"
-#include "utility-buffer.h"
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -54,11 +59,35 @@ extern "C"
 #define TRUE                                     true
 #define FALSE                                    false
 #endif
+#elif defined (__POSIX_HOST)
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#define TRUE                                     true
+#define FALSE                                    false
+
+/*!
+ * The interrupts of the host are threads: the critical sections are made
+ * with a mutex.
+ */
+#if (WCDLI_TX_BUFFER_DIMENSION > 0) || (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
+static pthread_mutex_t mHostCriticalSection = PTHREAD_MUTEX_INITIALIZER;
 #endif
-#endif
+#define WCDLI_ENTER_CRITICAL()                   pthread_mutex_lock(&mHostCriticalSection)
+#define WCDLI_EXIT_CRITICAL()                    pthread_mutex_unlock(&mHostCriticalSection)
+#define WCDLI_MEMORY_BARRIER()                   __sync_synchronize()
+#define WCDLI_CAN_WAIT_TX()                      TRUE
 
-#if !defined (WCDLI_MAX_CHARS_PER_LINE)
-#define WCDLI_MAX_CHARS_PER_LINE                 80
+#define NVIC_SystemReset()                       exit(EXIT_SUCCESS)
+#endif
 #endif
 
 #if !defined (WCDLI_MAX_CHARS_COMMAND_LINE)
@@ -69,10 +98,6 @@ extern "C"
 #define WCDLI_MAX_INDENTATION_CHAR               4
 #endif
 
-#if !defined (WCDLI_MAX_PARAMS)
-#define WCDLI_MAX_PARAMS                         10
-#endif
-
 #if !defined (WCDLI_MAX_EXTERNAL_COMMAND)
 #define WCDLI_MAX_EXTERNAL_COMMAND               20
 #endif
@@ -89,16 +114,111 @@ extern "C"
 #define WCDLI_PROMPT_CHAR                        '%'
 #endif
 
+#if !defined (WCDLI_CANCEL_CHAR)
+#define WCDLI_CANCEL_CHAR                        0x03
+#endif
+
+#if !defined (WCDLI_COMMAND_SEPARATOR)
+#define WCDLI_COMMAND_SEPARATOR                  ';'
+#endif
+
+/*!
+ * Number of lines of a batch run at every WCDLI_ckeck() call.
+ */
+#if !defined (WCDLI_BATCH_LINES_PER_CHECK)
+#define WCDLI_BATCH_LINES_PER_CHECK              8
+#endif
+
 #if !defined (WCDLI_DIVIDING_DESCRIPTION_CHAR)
 #define WCDLI_DIVIDING_DESCRIPTION_CHAR          ':'
 #endif
 
-#if !defined (WCDLI_BUFFER_DIMENSION)
-#define WCDLI_BUFFER_DIMENSION                   0x00FFu
+/*!
+ * Number of slots of the hash index of the static commands table. It must be
+ * a power of two and at least twice the number of static commands.
+ */
+#if !defined (WCDLI_COMMANDS_HASH_SIZE)
+#define WCDLI_COMMANDS_HASH_SIZE                 32
+#endif
+
+#if ((WCDLI_COMMANDS_HASH_SIZE & (WCDLI_COMMANDS_HASH_SIZE - 1)) != 0) || (WCDLI_COMMANDS_HASH_SIZE > 256)
+#error "WCDLI: WCDLI_COMMANDS_HASH_SIZE must be a power of two, not greater than 256."
+#endif
+
+/*!
+ * Number of seeds tried at init in order to find a collision-free hash.
+ */
+#if !defined (WCDLI_COMMANDS_HASH_MAX_SEED)
+#define WCDLI_COMMANDS_HASH_MAX_SEED             256
+#endif
+
+/*!
+ * Number of nodes of the radix-trie index of the runtime-registered commands
+ * and apps: every registration adds at most two nodes, plus the root.
+ */
+#if !defined (WCDLI_MAX_INDEX_NODES)
+#define WCDLI_MAX_INDEX_NODES                    ((2 * (WCDLI_MAX_EXTERNAL_COMMAND + WCDLI_MAX_EXTERNAL_APP)) + 1)
+#endif
+
+#if (WCDLI_MAX_INDEX_NODES > 255)
+#error "WCDLI: too many external commands and apps for the commands index."
+#endif
+
+/*!
+ * Number of staged bytes that starts a write with the
+ * WCDLI_OUTPUTFLUSH_ON_THRESHOLD policy.
+ */
+#if !defined (WCDLI_OUTPUT_FLUSH_THRESHOLD)
+#define WCDLI_OUTPUT_FLUSH_THRESHOLD             (WCDLI_OUTPUT_BUFFER_DIMENSION / 2)
+#endif
+
+/*!
+ * Number of deferred messages processed at every WCDLI_ckeck() call.
+ */
+#if !defined (WCDLI_DEFERRED_RECORDS_PER_CHECK)
+#define WCDLI_DEFERRED_RECORDS_PER_CHECK         4
+#endif
+
+/*!
+ * Number of queued log messages printed at every WCDLI_ckeck() call.
+ */
+#if !defined (WCDLI_LOG_RECORDS_PER_CHECK)
+#define WCDLI_LOG_RECORDS_PER_CHECK              8
+#endif
+
+#if !defined (WCDLI_ENTER_CRITICAL)
+#define WCDLI_ENTER_CRITICAL()                   uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define WCDLI_EXIT_CRITICAL()                    __set_PRIMASK(primask)
 #endif
 
-#if !defined (WCDLI_DEFAULT_OPERATIVE_MODE)
-#define WCDLI_DEFAULT_OPERATIVE_MODE             WCDLI_OPERATIVEMODE_COMMAND
+#if !defined (WCDLI_MEMORY_BARRIER)
+#define WCDLI_MEMORY_BARRIER()                   __DMB()
+#endif
+
+/*!
+ * TRUE when the caller can wait for the TX interrupt to drain the ring: out
+ * of the interrupt handlers and with the interrupts enabled.
+ */
+#if !defined (WCDLI_CAN_WAIT_TX)
+#define WCDLI_CAN_WAIT_TX()                      ((__get_IPSR() == 0u) && (__get_PRIMASK() == 0u))
+#endif
+
+/*!
+ * Baud rate emulated by the TX drain of the POSIX host, zero means no pacing.
+ */
+#if defined (__POSIX_HOST) && !defined (WCDLI_HOST_BAUDRATE)
+#define WCDLI_HOST_BAUDRATE                      0
+#endif
+
+/*!
+ * Number of bytes moved at once from the RX FIFO of the peripheral.
+ */
+#if !defined (WCDLI_RX_CHUNK_DIMENSION)
+#define WCDLI_RX_CHUNK_DIMENSION                 16
+#endif
+
+#if defined (__NUECLIPSE) && !defined (WCDLI_NUECLIPSE_TX_INTERRUPT)
+#define WCDLI_NUECLIPSE_TX_INTERRUPT             UART_INTEN_THREIEN_Msk
 #endif
 
 #define WCDLI_NEW_LINE                           "\r\n"
@@ -111,929 +231,4806 @@ extern "C"
 
 #define WCDLI_ENTER_DEBUG_MODE                   "---"
 
-static void resetBuffer (void);
-static void prompt (void);
-static void sayHello (void);
-static void reboot (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
-static void help (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
-static void manageDebugLevel (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
+#define WCDLI_ENTER_BINARY_MODE                  "###"
+
+#define WCDLI_END_BATCH                          "end"
+
+static void resetBuffer (WCDLI_Context_t* ctx);
+static void prompt (WCDLI_Context_t* ctx);
+static void sayHello (WCDLI_Context_t* ctx);
+static void reboot (void* app, int argc, const char* argv[]);
+static void help (void* app, int argc, const char* argv[]);
+static void manageDebugLevel (void* app, int argc, const char* argv[]);
+static void startBatch (void* app, int argc, const char* argv[]);
+#if (WCDLI_PROFILING > 0)
+static void printStats (void* app, uint8_t argc, const WCDLI_ArgValue_t argv[]);
+
+static const char* const mStatsActions[] = {"reset", NULL};
+static const WCDLI_ArgSchema_t mStatsArgs[] =
+{
+    WCDLI_ARG_ENUM("action",WCDLI_ARGFLAG_OPTIONAL,mStatsActions),
+};
+static const WCDLI_CommandSchema_t mStatsSchema = {mStatsArgs, 1, printStats};
+#endif
 
 #if !defined (LIBOHIBOARD_VERSION)
-static void Utility_getVersionString (const Utility_Version_t* version, char* toString)
+static void Utility_getVersionString (const Utility_Version_t* version, char* toString);
+#endif
+
+/*!
+ * The console of WCDLI_init(), and the first initialized console, where the
+ * deferred messages are printed.
+ */
+static WCDLI_Context_t mDefaultContext =
 {
-    uint8_t tmp[5] = {0};
-    uint8_t tmp2[32] = {0};
-
-    // Major
-    itoa(version->f.major,tmp,10);
-    //u16td(tmp,version->f.major);
-    strcat(toString,tmp);
-    strcat(toString,".");
-
-    // Minor
-    memset(tmp,0,sizeof(tmp));
-    itoa(version->f.minor,tmp,10);
-    //u16td(tmp,version->f.minor);
-    strcat(toString,tmp);
-    strcat(toString,".");
-
-    // Sub Minor
-    memset(tmp,0,sizeof(tmp));
-    itoa(version->f.subminor,tmp,10);
-    //u16td(tmp,version->f.subminor);
-    strcat(toString,tmp);
-    strcat(toString," of ");
+    .operativeMode = WCDLI_DEFAULT_OPERATIVE_MODE,
+    .debugLevel    = WCDLI_DEBUG_MESSAGE_LEVEL,
+#if defined (__POSIX_HOST)
+    .signal        = {-1, -1},
+#endif
+};
+WCDLI_Context_t* WCDLI_mainContext = &mDefaultContext;
 
-    //Time_unixtimeToString(version->f.time,tmp2);
-    //strcat(toString,tmp2);
+/*!
+ * The console whose lines WCDLI_ckeck_ex() is running, NULL elsewhere.
+ */
+static WCDLI_THREAD_LOCAL WCDLI_Context_t* mCurrentContext = NULL;
+
+/*!
+ * \return The console of the running command, the main console elsewhere.
+ */
+static inline WCDLI_Context_t* commandContext (void)
+{
+    return (mCurrentContext != NULL) ? mCurrentContext : WCDLI_mainContext;
+}
+
+/*!
+ * The messages without level are the answers of the commands, the others
+ * are logs of the main console.
+ */
+static inline WCDLI_Context_t* debugContext (WCDLI_MessageLevel_t level)
+{
+    return (level == WCDLI_MESSAGELEVEL_NONE) ? commandContext() : WCDLI_mainContext;
 }
-#endif
 
 #if defined (LIBOHIBOARD_VERSION)
-static Uart_DeviceHandle mDevice = {0};
-#else
-#if defined (__MCUXPRESSO)
-#if defined (__MCUXPRESSO_UART)
-static UART_Type* mDevice = {0};
-#elif defined (__MCUXPRESSO_USART)
-static USART_Type* mDevice = {0};
-#endif
-#elif defined (__NUECLIPSE)
-static UART_T* mDevice = {0};
-#endif
+/*!
+ * The initialized consoles, to find the context of a device.
+ */
+static WCDLI_Context_t* mContexts = NULL;
 #endif
 
-static WCDLI_MessageLevel_t mDebugLevel = WCDLI_DEBUG_MESSAGE_LEVEL;
-static WCDLI_OperativeMode_t mOperativeMode = WCDLI_DEFAULT_OPERATIVE_MODE;
+/*!
+ * Debug level of every registered module, and its name.
+ */
+uint8_t WCDLI_moduleLevels[WCDLI_MAX_MODULES] = {0};
+static const char* mModuleNames[WCDLI_MAX_MODULES] = {0};
+static uint8_t mModulesSize = 0;
 
 #if defined (LIBOHIBOARD_RTC)
-static void setTime (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
-static void getTime (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
+static void setTime (void* app, uint8_t argc, const WCDLI_ArgValue_t argv[]);
+static void getTime (void* app, int argc, const char* argv[]);
+
+static const WCDLI_ArgSchema_t mSetTimeArgs[] =
+{
+    WCDLI_ARG_UINT("unixtime",0,0,0),
+};
+static const WCDLI_CommandSchema_t mSetTimeSchema = {mSetTimeArgs, 1, setTime};
 #endif
 
 static const WCDLI_Command_t mCommands[] =
 {
-    {"help"    , "Commands list"                    , 0, help},
-    {"version" , "Project version"                  , 0, WCDLI_printProjectVersion},
-    {"status"  , "Microcontroller status"           , 0, WCDLI_printStatus},
-    {"debug"   , "Set/Get debug level with ?|[1-6]" , 0, manageDebugLevel},
+    {"help"    , "Commands list"                    , 0, 0, help, 0, 0, 0},
+    {"version" , "Project version"                  , 0, 0, WCDLI_printProjectVersion, 0, 0, 0},
+    {"status"  , "Microcontroller status"           , 0, 0, WCDLI_printStatus, 0, 0, 0},
+    {"debug"   , "Set/Get debug level with [module] ?|[1-6], list" , 0, 0, manageDebugLevel, 0, 0, 0},
+    {"batch"   , "Run the next lines up to end, without prompts" , 0, 0, startBatch, 0, 0, 0},
+#if (WCDLI_PROFILING > 0)
+    {"stats"   , "Commands duration, reset to clear" , 0, 0, 0, 0, 0, &mStatsSchema},
+#endif
 #if defined (LIBOHIBOARD_RTC)
-    {"settime" , "Set the current time"             , 0, setTime},
-    {"gettime" , "Return the current time"          , 0, getTime},
+    {"settime" , "Set the current time"             , 0, 0, 0, 0, 0, &mSetTimeSchema},
+    {"gettime" , "Return the current time"          , 0, 0, getTime, 0, 0, 0},
+#endif
+    {"save"    , "Save parameters"                  , 0, 0, WCDLI_save, 0, 0, 0},
+    {"reboot"  , "Reboot..."                        , 0, 0, reboot, 0, 0, 0},
+#if defined (WCDLI_USER_COMMANDS)
+    // Statically known user commands, defined into firmware.h as a list of
+    // WCDLI_Command_t initializers.
+    WCDLI_USER_COMMANDS
 #endif
-    {"save"    , "Save parameters"                  , 0, WCDLI_save},
-    {"reboot"  , "Reboot..."                        , 0, reboot},
 };
 
 #define WCDLI_COMMANDS_SIZE                      (sizeof(mCommands) / sizeof(mCommands[0]))
 
+/*!
+ * Hash index of the static commands table: each slot contains the position
+ * of the command into mCommands plus one, zero means empty slot.
+ * The table is built at init time, choosing the seed that gives no collision
+ * so that a lookup costs one hash and one compare.
+ */
+static uint8_t mCommandsHash[WCDLI_COMMANDS_HASH_SIZE] = {0};
+static uint32_t mCommandsHashSeed = 0;
+
+/*!
+ * The table size is known by the compiler only: a negative array size stops
+ * the build when WCDLI_USER_COMMANDS needs a greater WCDLI_COMMANDS_HASH_SIZE.
+ */
+typedef char WCDLI_CommandsHashSizeCheck_t[((WCDLI_COMMANDS_SIZE * 2) <= WCDLI_COMMANDS_HASH_SIZE) ? 1 : -1];
+
+static bool mCommandsHashIsPerfect = FALSE;
+
 static WCDLI_Command_t mExternalCommands[WCDLI_MAX_EXTERNAL_COMMAND];
 static uint8_t mExternalCommandsIndex = 0;
 
 static WCDLI_Command_t mExternalApps[WCDLI_MAX_EXTERNAL_APP];
 static uint8_t mExternalAppsIndex = 0;
 
-static char mPromptString[6] = {0};
-
+#if (WCDLI_PROFILING > 0)
 /*!
- * The buffer for the incoming command.
+ * The profile of the commands, at the same position of the command into
+ * its table.
  */
-static char mBuffer[WCDLI_BUFFER_DIMENSION+1] = {0};
-
-static uint32_t mCurrentCommandIndex = 0;
-static char mCurrentCommand[WCDLI_MAX_CHARS_PER_LINE] = {0};
+static WCDLI_CommandStats_t mCommandsStats[WCDLI_COMMANDS_SIZE];
+static WCDLI_CommandStats_t mExternalCommandsStats[WCDLI_MAX_EXTERNAL_COMMAND];
+static WCDLI_CommandStats_t mExternalAppsStats[WCDLI_MAX_EXTERNAL_APP];
+#endif
 
-static char mParams[WCDLI_MAX_PARAMS][WCDLI_BUFFER_SIZE];
-static uint8_t mNumberOfParams = 0;
+/*!
+ * Node of the radix-trie index of runtime-registered commands and apps.
+ * The label points into the registered name, so no name is copied.
+ */
+typedef struct _WCDLI_IndexNode_t
+{
+    const char* label;
+    uint8_t length;
+    uint8_t child;               /*!< First child, zero means no child */
+    uint8_t sibling;             /*!< Next sibling, zero means no sibling */
+    const WCDLI_Command_t* command;
+} WCDLI_IndexNode_t;
 
 /*!
- *
+ * The radix-trie index, the first node is the root.
  */
-static UtilityBuffer_Descriptor mBufferDescriptor;
+static WCDLI_IndexNode_t mIndexNodes[WCDLI_MAX_INDEX_NODES] = {0};
+static uint8_t mIndexNodesSize = 1;
 
-#define WCDLI_PRINT_DIVIDING_LINE()              \
-    do {                                         \
-      uint8_t c = WCDLI_DIVIDING_CHAR;           \
-      for (i=0; i<WCDLI_MAX_CHARS_PER_LINE; ++i) \
-          Uart_write(mDevice,&c,100);       \
-    } while (0)
+static char mPromptString[6] = {0};
 
-#define WCDLI_PRINT_NEW_LINE()                      \
-    do {                                            \
-        Uart_sendString(mDevice,WCDLI_NEW_LINE);\
-    } while (0)
+static inline void ringInit (WCDLI_Ring_t* ring, uint8_t* data, uint16_t size)
+{
+    ring->data = data;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+}
 
-#if defined (LIBOHIBOARD_VERSION)
-void callbackRx (struct _Uart_Device* dev, void* obj)
+static inline uint16_t ringCount (const WCDLI_Ring_t* ring)
 {
-    (void)obj;
+    uint16_t head = ring->head;
+    uint16_t tail = ring->tail;
 
-    uint8_t c = 0;
-    Uart_read(dev,&c,100);
+    return (head >= tail) ? (head - tail) : (ring->size - tail + head);
+}
 
-    UtilityBuffer_push(&mBufferDescriptor,c);
+static inline uint16_t ringFree (const WCDLI_Ring_t* ring)
+{
+    return ring->size - 1 - ringCount(ring);
 }
-#else
-#if defined (__MCUXPRESSO)
-#if defined (__MCUXPRESSO_UART)
-void WCDLI_callbackRx (UART_Type* base, void* obj)
+
+/*!
+ * Copy as many bytes as fit with at most two moves.
+ *
+ * \return The number of bytes written.
+ */
+static inline uint16_t ringWrite (WCDLI_Ring_t* ring, const uint8_t* data, uint16_t length)
 {
-    (void)obj;
-    uint8_t c;
-    // put the new received byte in the buffer
-    uint32_t UartFlags = UART_GetStatusFlags(base);
-    if ((kUART_RxDataRegFullFlag) & UartFlags)
+    uint16_t head = ring->head;
+    uint16_t first = ring->size - head;
+    uint16_t free = ringFree(ring);
+
+    if (length > free)
     {
-        c = UART_ReadByte(base);
-        UtilityBuffer_push(&mBufferDescriptor,c);
+        length = free;
     }
-}
-#elif defined (__MCUXPRESSO_USART)
-void WCDLI_callbackRx (USART_Type* base, void* obj)
-#endif
-{
-    (void)obj;
-    uint8_t c;
-    // put the new received byte in the buffer
-    uint32_t UartFlags = USART_GetStatusFlags(base);
-    if ((kUSART_RxFifoNotEmptyFlag) & UartFlags)
+    if (first > length)
     {
-        c = USART_ReadByte(base);
-        UtilityBuffer_push(&mBufferDescriptor,c);
+        first = length;
     }
-    //USART_ClearStatusFlags(base,kUSART_AllClearFlags);
-}
-#elif defined (__NUECLIPSE)
-// FIXME
-void WCDLI_callbackRx (UART_T* base, void* obj)
-{
-    (void)obj;
-    uint8_t c;
 
-    UART_Read(base,&c,1);
-    UtilityBuffer_push(&mBufferDescriptor,c);
-}
-#else
-#error "[ERROR] No interrupt implementation."
-#endif
-#endif
+    memcpy(&ring->data[head],data,first);
+    memcpy(&ring->data[0],&data[first],length - first);
 
-#if !defined (LIBOHIBOARD_VERSION)
-#if defined (__MCUXPRESSO)
-#if defined (__MCUXPRESSO_UART)
-static void Uart_write (UART_Type* dev, const uint8_t* data, uint32_t timeout)
-{
-    UART_WriteBlocking(dev,(const uint8_t *)data,1);
-}
-#elif defined (__MCUXPRESSO_USART)
-static void Uart_write (USART_Type* dev, const uint8_t* data, uint32_t timeout)
-{
-    USART_WriteBlocking(dev,(const uint8_t *)data,1);
+    head += length;
+    if (head >= ring->size)
+    {
+        head -= ring->size;
+    }
+    // The bytes must be in memory before the consumer can see them
+    WCDLI_MEMORY_BARRIER();
+    ring->head = head;
+    return length;
 }
-#endif
 
-#if defined (__MCUXPRESSO_UART)
-static void Uart_sendString (UART_Type* dev, const char* text)
-{
-    uint16_t len = strlen(text);
-    UART_WriteBlocking(dev,(const uint8_t *)text,len);
-}
-#elif defined (__MCUXPRESSO_USART)
-static void Uart_sendString (USART_Type* dev, const char* text)
+/*!
+ * \param[out] data: The first readable byte.
+ * \return The number of contiguous readable bytes.
+ */
+static inline uint16_t ringPeek (const WCDLI_Ring_t* ring, const uint8_t** data)
 {
-    uint16_t len = strlen(text);
-    USART_WriteBlocking(dev,(const uint8_t *)text,len);
-}
-#endif
+    uint16_t head = ring->head;
+    uint16_t tail = ring->tail;
 
-#if defined (__MCUXPRESSO_UART)
-static void Uart_sendStringln (UART_Type* dev, const char* text)
-{
-    uint16_t len = strlen(text);
-    UART_WriteBlocking(dev,(const uint8_t *)text,len);
-    UART_WriteBlocking(dev,(const uint8_t *)"\r\n",2);
+    *data = &ring->data[tail];
+    return (head >= tail) ? (head - tail) : (ring->size - tail);
 }
-#elif defined (__MCUXPRESSO_USART)
-static void Uart_sendStringln (USART_Type* dev, const char* text)
-{
-    uint16_t len = strlen(text);
-    USART_WriteBlocking(dev,(const uint8_t *)text,len);
-    USART_WriteBlocking(dev,(const uint8_t *)"\r\n",2);
-}
-#endif
 
-#elif defined (__NUECLIPSE)
-static void Uart_write (UART_T* dev, const uint8_t* data, uint32_t timeout)
+static inline void ringSkip (WCDLI_Ring_t* ring, uint16_t length)
 {
-    UART_Write(dev,(uint8_t *)data,1);
+    uint16_t tail = ring->tail + length;
+
+    if (tail >= ring->size)
+    {
+        tail -= ring->size;
+    }
+    ring->tail = tail;
 }
 
-static void Uart_sendString (UART_T* dev, const char* text)
+/*!
+ * Copy the bytes out of the ring and release them.
+ */
+static inline void ringRead (WCDLI_Ring_t* ring, uint8_t* data, uint16_t length)
 {
-    uint16_t len = strlen(text);
-    UART_Write(dev,(uint8_t *)text,len);
+    const uint8_t* span = NULL;
+    uint16_t chunk = 0;
+
+    while (length > 0)
+    {
+        chunk = ringPeek(ring,&span);
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+        memcpy(data,span,chunk);
+        ringSkip(ring,chunk);
+        data += chunk;
+        length -= chunk;
+    }
 }
 
-static void Uart_sendStringln (UART_T* dev, const char* text)
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+
+#if !defined (WCDLI_ATOMIC_CAS)
+#if defined (__ARM_ARCH_6M__)
+/*!
+ * The cores without exclusive access use a short critical section: it is
+ * never preempted, so the producers still never wait for each other.
+ */
+static inline bool atomicCas (volatile uint32_t* value, uint32_t* expected, uint32_t desired)
 {
-    uint16_t len = strlen(text);
-    UART_Write(dev,(uint8_t *)text,len);
-    UART_Write(dev,(uint8_t *)"\r\n",2);
+    bool isDone = FALSE;
+
+    WCDLI_ENTER_CRITICAL();
+    if (*value == *expected)
+    {
+        *value = desired;
+        isDone = TRUE;
+    }
+    else
+    {
+        *expected = *value;
+    }
+    WCDLI_EXIT_CRITICAL();
+    return isDone;
 }
+#define WCDLI_ATOMIC_CAS(VALUE,EXPECTED,DESIRED) atomicCas(VALUE,EXPECTED,DESIRED)
 #else
-#error "[ERROR] Implement UART wrapper functions."
+#define WCDLI_ATOMIC_CAS(VALUE,EXPECTED,DESIRED) \
+    __atomic_compare_exchange_n(VALUE,EXPECTED,DESIRED,FALSE,__ATOMIC_ACQ_REL,__ATOMIC_RELAXED)
 #endif
 #endif
 
-static void resetBuffer (void)
-{
-    mCurrentCommandIndex = 0;
-}
+#if !defined (WCDLI_ATOMIC_LOAD)
+#define WCDLI_ATOMIC_LOAD(VALUE)                 __atomic_load_n(VALUE,__ATOMIC_ACQUIRE)
+#define WCDLI_ATOMIC_STORE(VALUE,NEW)            __atomic_store_n(VALUE,NEW,__ATOMIC_RELEASE)
+#endif
 
-static void prompt (void)
+static void logInit (WCDLI_LogQueue_t* queue)
 {
-    resetBuffer();
-    Uart_sendString(mDevice, mPromptString);
+    for (uint32_t i = 0; i < WCDLI_LOG_QUEUE_SLOTS; ++i)
+    {
+        queue->records[i].sequence = i;
+    }
+    queue->head = 0;
+    queue->tail = 0;
+    queue->lost = 0;
 }
 
-static void printLibraryVersion (void)
+/*!
+ * Reserve the slot of a message. The producers race on the head with a
+ * compare and swap and never wait: when the queue is full the message is
+ * counted as lost.
+ *
+ * \param[out] position: The position to commit.
+ * \return The slot to fill, NULL when the queue is full.
+ */
+static WCDLI_LogRecord_t* logReserve (WCDLI_LogQueue_t* queue, uint32_t* position)
 {
-    char versionString[64] = {0};
-    char message[WCDLI_MAX_CHARS_PER_LINE] = {0};
+    WCDLI_LogRecord_t* record = NULL;
+    uint32_t head = WCDLI_ATOMIC_LOAD(&queue->head);
+    uint32_t lost = 0;
+    int32_t difference = 0;
 
-#if !defined (LIBOHIBOARD_VERSION)
-    static const Utility_Version_t WCDLI_FIRMWARE_VERSION =
+    for (;;)
     {
+        record = &queue->records[head & (WCDLI_LOG_QUEUE_SLOTS - 1)];
+        difference = (int32_t)(WCDLI_ATOMIC_LOAD(&record->sequence) - head);
+
+        if (difference == 0)
         {
-            WARCOMEB_WCDLI_LIBRARY_VERSION_MAJOR,
-            WARCOMEB_WCDLI_LIBRARY_VERSION_MINOR,
-            WARCOMEB_WCDLI_LIBRARY_VERSION_BUG,
-            WARCOMEB_WCDLI_LIBRARY_TIME
+            // The slot is free: on failure head is reloaded by the swap
+            if (WCDLI_ATOMIC_CAS(&queue->head,&head,head + 1))
+            {
+                *position = head;
+                return record;
+            }
         }
-    };
-#endif
-    Utility_getVersionString(&WCDLI_FIRMWARE_VERSION,versionString);
+        else if (difference < 0)
+        {
+            // The consumer has not released the slot yet
+            lost = WCDLI_ATOMIC_LOAD(&queue->lost);
+            while (!WCDLI_ATOMIC_CAS(&queue->lost,&lost,lost + 1))
+            {
+                // Another producer counted a loss
+            }
+            return NULL;
+        }
+        else
+        {
+            // Another producer took the slot
+            head = WCDLI_ATOMIC_LOAD(&queue->head);
+        }
+    }
+}
 
-    memset(message,0,sizeof(message));
-    strcat(message,WCDLI_PROJECT_NAME);
-    strcat(message," : ");
-    strcat(message,versionString);
-    Uart_sendStringln(mDevice, message);
+/*!
+ * Hand the message to the consumer.
+ */
+static inline void logCommit (WCDLI_LogRecord_t* record, uint32_t position)
+{
+    // The release store makes the text visible before the sequence
+    WCDLI_ATOMIC_STORE(&record->sequence,position + 1);
 }
 
-static void sayHello (void)
+/*!
+ * \return The oldest message, NULL when the queue is empty or the oldest
+ *         message is not committed yet.
+ */
+static inline WCDLI_LogRecord_t* logPeek (WCDLI_LogQueue_t* queue)
 {
-    uint8_t i = 0;
+    WCDLI_LogRecord_t* record = &queue->records[queue->tail & (WCDLI_LOG_QUEUE_SLOTS - 1)];
 
-    WCDLI_PRINT_NEW_LINE();
-    WCDLI_PRINT_DIVIDING_LINE();
-    WCDLI_PRINT_NEW_LINE();
+    if (WCDLI_ATOMIC_LOAD(&record->sequence) != (queue->tail + 1))
+    {
+        return NULL;
+    }
+    return record;
+}
 
-    printLibraryVersion();
+/*!
+ * Give the slot back to the producers, for the next round of the queue.
+ */
+static inline void logRelease (WCDLI_LogQueue_t* queue, WCDLI_LogRecord_t* record)
+{
+    WCDLI_ATOMIC_STORE(&record->sequence,queue->tail + WCDLI_LOG_QUEUE_SLOTS);
+    queue->tail++;
+}
 
-    WCDLI_PRINT_DIVIDING_LINE();
-    WCDLI_PRINT_NEW_LINE();
+#endif // WCDLI_LOG_QUEUE_SLOTS
 
-#if (defined (PROJECT_NAME) || defined (PROJECT_COPYRIGTH))
-#if defined (PROJECT_NAME)
-    Uart_sendStringln(mDevice, PROJECT_NAME);
-#endif
-#if defined (PROJECT_COPYRIGTH)
-    Uart_sendStringln(mDevice, PROJECT_COPYRIGTH);
-#endif
-    WCDLI_PRINT_DIVIDING_LINE();
-    WCDLI_PRINT_NEW_LINE();
+#if (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
+/*!
+ * The buffer of the deferred messages: every record is made of the header
+ * byte, the address of the format string, the timestamp and the arguments.
+ */
+static uint8_t mDeferredBuffer[WCDLI_DEFERRED_BUFFER_DIMENSION+1] = {0};
+static WCDLI_Ring_t mDeferredRing;
+static volatile uint32_t mDeferredLost = 0;
+static WCDLI_DeferredOutput_t mDeferredOutput = WCDLI_DEFERRED_OUTPUT;
 #endif
 
-    WCDLI_printProjectVersion(0,0,0);
-    WCDLI_PRINT_DIVIDING_LINE();
-    WCDLI_PRINT_NEW_LINE();
+#define WCDLI_PRINT_DIVIDING_LINE(CTX)                                \
+    do {                                                              \
+        writeChars(CTX,WCDLI_DIVIDING_CHAR,WCDLI_MAX_CHARS_PER_LINE); \
+    } while (0)
+
+#define WCDLI_PRINT_NEW_LINE(CTX)                   \
+    do {                                            \
+        writeString(CTX,WCDLI_NEW_LINE);            \
+    } while (0)
+
+/*!
+ * The context passed to the interrupt callbacks, NULL for the console of
+ * WCDLI_init().
+ */
+static inline WCDLI_Context_t* getContext (void* obj)
+{
+    return (obj != NULL) ? (WCDLI_Context_t*)obj : &mDefaultContext;
 }
 
-static void reboot (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+/*!
+ * Store a span of received bytes into the RX ring: the ends of line, and the
+ * lines too long, are counted and wake the console once.
+ */
+static inline void rxFeed (WCDLI_Context_t* ctx, const uint8_t* data, size_t length)
 {
-    WCDLI_PRINT_CMD_MESSAGE("Reboot...");
-    NVIC_SystemReset();
+    const uint8_t* lf = NULL;
+    uint16_t lines = 0;
+    uint16_t waiting = 0;
+    // The packets of the binary mode end with their delimiter
+    int end = (ctx->operativeMode == WCDLI_OPERATIVEMODE_BINARY) ? WCDLI_BINARY_DELIMITER : '\n';
+    size_t received = length;
+
+    // The bytes over the free room are lost
+    length = ringWrite(&ctx->rxRing,data,(length > 0xFFFFu) ? 0xFFFFu : (uint16_t)length);
+
+    ctx->counters.rxBytes += received;
+    ctx->counters.rxOverruns += received - length;
+    waiting = ringCount(&ctx->rxRing);
+    if (waiting > ctx->counters.rxHighWater)
+    {
+        ctx->counters.rxHighWater = waiting;
+    }
+
+    // Pause the remote before the ring overflows
+    if ((ctx->flowControl != WCDLI_FLOWCONTROL_NONE) && (ctx->isRxPaused == FALSE) &&
+        (waiting >= WCDLI_RX_HIGH_WATERMARK))
+    {
+        ctx->isRxPaused = TRUE;
+        ctx->counters.rxPauses++;
+        WCDLI_setRxFlow(ctx,FALSE);
+    }
+
+    // Ctrl-C cancels the running command
+    if ((end == '\n') && (memchr(data,WCDLI_CANCEL_CHAR,length) != NULL))
+    {
+        ctx->isCancelRequested = TRUE;
+        WCDLI_signal(ctx);
+    }
+
+    while ((lf = memchr(data,end,length)) != NULL)
+    {
+        lines++;
+        length -= (lf + 1 - data);
+        data = lf + 1;
+        ctx->rxLength = 0;
+    }
+
+    if ((ctx->rxLength + length) >= WCDLI_MAX_CHARS_PER_LINE)
+    {
+        ctx->rxLength = 0;
+        lines++;
+    }
+    else
+    {
+        ctx->rxLength += length;
+    }
+
+    if (lines > 0)
+    {
+        ctx->rxEvents += lines;
+        WCDLI_signal(ctx);
+    }
 }
 
-static void help (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+static inline void rxPush (WCDLI_Context_t* ctx, uint8_t c)
 {
-    uint8_t noBlank = 0;
-    uint8_t c = ' ';
+    rxFeed(ctx,&c,1);
+}
 
-    for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; ++i)
+void WCDLI_feed_ex (WCDLI_Context_t* ctx, const uint8_t* data, size_t length)
+{
+    rxFeed(ctx,data,length);
+}
+
+void WCDLI_feed (const uint8_t* data, size_t length)
+{
+    rxFeed(WCDLI_mainContext,data,length);
+}
+
+void WCDLI_feedCircular_ex (WCDLI_Context_t* ctx, const uint8_t* buffer, uint16_t size, uint16_t position)
+{
+    uint16_t last = ctx->rxCircularPosition;
+
+    if (position >= size)
+    {
+        position = 0;
+    }
+
+    if (position < last)
+    {
+        // The DMA wrapped: the tail of the buffer first
+        rxFeed(ctx,&buffer[last],size - last);
+        last = 0;
+    }
+    rxFeed(ctx,&buffer[last],position - last);
+    ctx->rxCircularPosition = position;
+}
+
+void WCDLI_feedCircular (const uint8_t* buffer, uint16_t size, uint16_t position)
+{
+    WCDLI_feedCircular_ex(WCDLI_mainContext,buffer,size,position);
+}
+
+#if defined (LIBOHIBOARD_VERSION)
+void callbackRx (struct _Uart_Device* dev, void* obj)
+{
+    (void)obj;
+    WCDLI_Context_t* ctx = mContexts;
+
+    uint8_t c = 0;
+    Uart_read(dev,&c,100);
+
+    // The driver does not know the console: look for the device
+    while ((ctx != NULL) && (ctx->device != dev))
+    {
+        ctx = ctx->next;
+    }
+    if (ctx != NULL)
+    {
+        rxPush(ctx,c);
+    }
+}
+#else
+#if defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+void WCDLI_callbackRx (UART_Type* base, void* obj)
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    uint8_t data[WCDLI_RX_CHUNK_DIMENSION];
+    uint16_t length = 0;
+
+    // Drain the whole FIFO, the bytes are stored as a span
+    do
     {
-        noBlank = WCDLI_MAX_CHARS_COMMAND_LINE - strlen(mCommands[i].name);
-        Uart_sendString(mDevice,mCommands[i].name);
-        c = ' ';
-        for (uint8_t j=0; j < noBlank; ++j)
+        length = 0;
+        while ((length < sizeof(data)) && ((kUART_RxDataRegFullFlag) & UART_GetStatusFlags(base)))
         {
-            Uart_write(mDevice,&c,100);
+            data[length++] = UART_ReadByte(base);
         }
-        c = WCDLI_DIVIDING_DESCRIPTION_CHAR;
-        Uart_write(mDevice,&c,100);
-        c = ' ';
-        Uart_write(mDevice,&c,100);
-        Uart_sendStringln(mDevice,mCommands[i].description);
-    }
+        rxFeed(ctx,data,length);
+    } while (length == sizeof(data));
+}
+#elif defined (__MCUXPRESSO_USART)
+void WCDLI_callbackRx (USART_Type* base, void* obj)
+#endif
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    uint8_t data[WCDLI_RX_CHUNK_DIMENSION];
+    uint16_t length = 0;
 
-    for (uint8_t i = 0; i < mExternalCommandsIndex; ++i)
+    // Drain the whole FIFO, the bytes are stored as a span
+    do
     {
-        noBlank = WCDLI_MAX_CHARS_COMMAND_LINE - strlen(mExternalCommands[i].name);
-        Uart_sendString(mDevice,mExternalCommands[i].name);
-        c = ' ';
-        for (uint8_t j=0; j < noBlank; ++j)
+        length = 0;
+        while ((length < sizeof(data)) && ((kUSART_RxFifoNotEmptyFlag) & USART_GetStatusFlags(base)))
         {
-            Uart_write(mDevice,&c,100);
+            data[length++] = USART_ReadByte(base);
         }
-        c = WCDLI_DIVIDING_DESCRIPTION_CHAR;
-        Uart_write(mDevice,&c,100);
-        c = ' ';
-        Uart_write(mDevice,&c,100);
-        Uart_sendStringln(mDevice,mExternalCommands[i].description);
-    }
+        rxFeed(ctx,data,length);
+    } while (length == sizeof(data));
+    //USART_ClearStatusFlags(base,kUSART_AllClearFlags);
+}
+#elif defined (__NUECLIPSE)
+// FIXME
+void WCDLI_callbackRx (UART_T* base, void* obj)
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    uint8_t data[WCDLI_RX_CHUNK_DIMENSION];
+    uint16_t length = 0;
 
-    for (uint8_t i = 0; i < mExternalAppsIndex; ++i)
+    // Drain the whole FIFO, the bytes are stored as a span
+    do
+    {
+        length = 0;
+        while ((length < sizeof(data)) && !UART_GET_RX_EMPTY(base))
+        {
+            data[length++] = UART_READ(base);
+        }
+        rxFeed(ctx,data,length);
+    } while (length == sizeof(data));
+}
+#elif defined (__POSIX_HOST)
+void WCDLI_callbackRx (WCDLI_HostDevice_t* base, void* obj)
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    struct pollfd event = {.fd = base->rx, .events = POLLIN};
+    uint8_t data[64];
+    ssize_t length = 0;
+
+    // A paused remote sends nothing more
+    while ((base->isRxReady == TRUE) && (poll(&event,1,0) > 0) && ((event.revents & POLLIN) != 0))
     {
-        noBlank = WCDLI_MAX_CHARS_COMMAND_LINE - strlen(mExternalApps[i].name);
-        Uart_sendString(mDevice,mExternalApps[i].name);
-        c = ' ';
-        for (uint8_t j=0; j < noBlank; ++j)
+        length = read(base->rx,data,sizeof(data));
+        if (length <= 0)
         {
-            Uart_write(mDevice,&c,100);
+            break;
         }
-        c = WCDLI_DIVIDING_DESCRIPTION_CHAR;
-        Uart_write(mDevice,&c,100);
-        c = ' ';
-        Uart_write(mDevice,&c,100);
-        Uart_sendStringln(mDevice,mExternalApps[i].description);
 
-        mExternalApps[i].callback(mExternalApps[i].device,1,0);
-    }
+        const uint8_t* span = data;
+        const uint8_t* end = &data[length];
+        const uint8_t* lf = NULL;
 
-    WCDLI_PRINT_NEW_LINE();
+        while ((lf = memchr(span,'\n',end - span)) != NULL)
+        {
+            // Line oriented hosts end the lines with LF only
+            if (((lf > data) ? lf[-1] : ctx->lastRx) != '\r')
+            {
+                rxFeed(ctx,span,lf - span);
+                rxPush(ctx,'\r');
+                span = lf;
+            }
+            rxFeed(ctx,span,lf + 1 - span);
+            span = lf + 1;
+        }
+        rxFeed(ctx,span,end - span);
+        ctx->lastRx = data[length-1];
+    }
 }
 
-static void manageDebugLevel (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+static void hostWrite (int fd, const uint8_t* data, size_t length)
 {
-    if ((argc == 2) && (strlen(&argv[1][0]) == 1))
+    ssize_t written = 0;
+
+    while (length > 0)
     {
-        if (argv[1][0] == '?')
+        written = write(fd,data,length);
+        if (written < 0)
         {
-            WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_NONE,"Current debug level is %d\r\n",mDebugLevel);
+            if (errno == EINTR)
+            {
+                continue;
+            }
             return;
         }
+        data += written;
+        length -= written;
     }
+}
 
-    // Send wrong command message!
-    WCDLI_PRINT_WRONG_COMMAND();
+static int hostSetRaw (int fd)
+{
+    struct termios settings;
+
+    if (tcgetattr(fd,&settings) != 0)
+    {
+        return -1;
+    }
+    cfmakeraw(&settings);
+    return tcsetattr(fd,TCSANOW,&settings);
 }
 
-#if defined (LIBOHIBOARD_RTC)
-static void setTime (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+int WCDLI_hostOpenStdio (WCDLI_HostDevice_t* dev)
+{
+    dev->rx   = STDIN_FILENO;
+    dev->tx   = STDOUT_FILENO;
+    dev->peer = -1;
+    return 0;
+}
+
+int WCDLI_hostOpenPty (WCDLI_HostDevice_t* dev)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0))
+    {
+        return -1;
+    }
+
+    // Keep the slave side open: the master reports errors without a peer
+    dev->peer = open(ptsname(master),O_RDWR | O_NOCTTY);
+    if ((dev->peer < 0) || (hostSetRaw(dev->peer) != 0))
+    {
+        close(master);
+        return -1;
+    }
+    dev->rx = master;
+    dev->tx = master;
+    return 0;
+}
+
+const char* WCDLI_hostGetPtyName (WCDLI_HostDevice_t* dev)
+{
+    return ptsname(dev->rx);
+}
+
+int WCDLI_hostOpenSocketpair (WCDLI_HostDevice_t* dev)
+{
+    int pair[2];
+
+    if (socketpair(AF_UNIX,SOCK_STREAM,0,pair) != 0)
+    {
+        return -1;
+    }
+    dev->rx   = pair[0];
+    dev->tx   = pair[0];
+    dev->peer = pair[1];
+    return 0;
+}
+
+/*!
+ * Open the non-blocking pipe written by WCDLI_signal().
+ */
+static void hostOpenSignal (WCDLI_Context_t* ctx)
 {
-    if (argc == 2)
+    if (pipe(ctx->signal) != 0)
     {
-        uint32_t myTime = atoi (&argv[1][0]);
-        Rtc_setTime(OB_RTC0, myTime);
+        ctx->signal[0] = -1;
+        ctx->signal[1] = -1;
         return;
     }
+    fcntl(ctx->signal[0],F_SETFL,fcntl(ctx->signal[0],F_GETFL) | O_NONBLOCK);
+    fcntl(ctx->signal[1],F_SETFL,fcntl(ctx->signal[1],F_GETFL) | O_NONBLOCK);
+}
 
-    // Send wrong command message!
-    WCDLI_PRINT_WRONG_COMMAND();
+static void hostDrainSignal (WCDLI_Context_t* ctx)
+{
+    uint8_t data[16];
+
+    while ((ctx->signal[0] >= 0) && (read(ctx->signal[0],data,sizeof(data)) > 0))
+    {
+        // Only the wake up matters
+    }
 }
 
-static void getTime (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+int WCDLI_hostGetSignalFd (WCDLI_Context_t* ctx)
 {
-    // TODO
-    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+    return ctx->signal[0];
 }
+#else
+#error "[ERROR] No interrupt implementation."
+#endif
+#endif
+
+#if defined (__POSIX_HOST)
+#define WCDLI_CYCLES_UNIT                        "ns"
+#elif defined (DWT_CTRL_CYCCNTENA_Msk)
+#define WCDLI_CYCLES_UNIT                        "cycles"
+#else
+#define WCDLI_CYCLES_UNIT                        "ticks"
 #endif
 
-_weak void WCDLI_save (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+_weak uint32_t WCDLI_getCycles (void)
 {
-    // TODO
-    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+#if defined (__POSIX_HOST)
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint32_t)(((uint64_t)now.tv_sec * 1000000000u) + now.tv_nsec);
+#elif defined (DWT_CTRL_CYCCNTENA_Msk)
+    return DWT->CYCCNT;
+#elif defined (LIBOHIBOARD_VERSION)
+    return System_currentTick();
+#else
+    return 0;
+#endif
+}
+
+_weak uint32_t WCDLI_getTimestamp (void)
+{
+#if defined (__POSIX_HOST)
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint32_t)(((uint64_t)now.tv_sec * 1000000u) + (now.tv_nsec / 1000u));
+#elif defined (LIBOHIBOARD_VERSION)
+    return System_currentTick();
+#else
+    return 0;
+#endif
+}
+
+/*!
+ * Start the cycle counter, where there is one.
+ */
+static void initCycles (void)
+{
+#if !defined (__POSIX_HOST) && defined (DWT_CTRL_CYCCNTENA_Msk)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
 }
 
 /*!
- * \param[out]    command:
- * \param[out] changeMode:
+ * Blocking write of a span on the serial peripheral.
  */
-static void parseCommand (WCDLI_Command_t* command, bool* changeMode)
+static inline void Uart_writeBlocking (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length)
 {
-    if (mOperativeMode == WCDLI_OPERATIVEMODE_COMMAND)
+#if defined (LIBOHIBOARD_VERSION)
+    for (uint16_t i = 0; i < length; ++i)
     {
-        for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; i++)
-        {
-            if (strncmp(mCurrentCommand, mCommands[i].name, strlen(mCommands[i].name)) == 0)
-            {
-                command->name        = mCommands[i].name;
-                command->description = mCommands[i].description;
-                command->callback    = mCommands[i].callback;
-                command->device      = 0;
+        Uart_write(ctx->device,&data[i],100);
+    }
+#elif defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+    UART_WriteBlocking(ctx->device,data,length);
+#elif defined (__MCUXPRESSO_USART)
+    USART_WriteBlocking(ctx->device,data,length);
+#endif
+#elif defined (__NUECLIPSE)
+    UART_Write(ctx->device,(uint8_t *)data,length);
+#elif defined (__POSIX_HOST)
+    hostWrite(ctx->device->tx,data,length);
+#else
+#error "[ERROR] Implement UART wrapper functions."
+#endif
+}
 
-                *changeMode = FALSE;
-                return;
-            }
-        }
+#if (WCDLI_TX_BUFFER_DIMENSION > 0)
 
-        for (uint8_t i = 0; i < mExternalCommandsIndex; i++)
-        {
-            if (strncmp(mCurrentCommand, mExternalCommands[i].name, strlen(mExternalCommands[i].name)) == 0)
-            {
-                command->name        = mExternalCommands[i].name;
-                command->description = mExternalCommands[i].description;
-                command->callback    = mExternalCommands[i].callback;
-                command->device      = 0;
+/*!
+ * Move the bytes of the TX ring to the peripheral from the interrupt
+ * handler, and stop the interrupt when the ring is empty.
+ */
+#if defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+void WCDLI_callbackTx (UART_Type* base, void* obj)
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    const uint8_t* data = NULL;
 
-                *changeMode = FALSE;
-                return;
-            }
-        }
+    while ((kUART_TxDataRegEmptyFlag & UART_GetStatusFlags(base)) &&
+           (ringPeek(&ctx->txRing,&data) > 0))
+    {
+        UART_WriteByte(base,data[0]);
+        ringSkip(&ctx->txRing,1);
+    }
 
-        for (uint8_t i = 0; i < mExternalAppsIndex; i++)
-        {
-            if (strncmp(mCurrentCommand, mExternalApps[i].name, strlen(mExternalApps[i].name)) == 0)
-            {
-                command->name        = mExternalApps[i].name;
-                command->description = mExternalApps[i].description;
-                command->callback    = mExternalApps[i].callback;
-                command->device      = mExternalApps[i].device;
+    if (ringCount(&ctx->txRing) == 0)
+    {
+        UART_DisableInterrupts(base,kUART_TxDataRegEmptyInterruptEnable);
+    }
+}
+#elif defined (__MCUXPRESSO_USART)
+void WCDLI_callbackTx (USART_Type* base, void* obj)
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    const uint8_t* data = NULL;
 
-                *changeMode = FALSE;
-                return;
-            }
-        }
+    while ((kUSART_TxFifoNotFullFlag & USART_GetStatusFlags(base)) &&
+           (ringPeek(&ctx->txRing,&data) > 0))
+    {
+        USART_WriteByte(base,data[0]);
+        ringSkip(&ctx->txRing,1);
     }
 
-    if (((strncmp(mCurrentCommand, WCDLI_ENTER_COMMAND_MODE, strlen(WCDLI_ENTER_COMMAND_MODE)) == 0) &&
-         (mOperativeMode == WCDLI_OPERATIVEMODE_DEBUG)) ||
-        ((strncmp(mCurrentCommand, WCDLI_ENTER_DEBUG_MODE, strlen(WCDLI_ENTER_DEBUG_MODE)) == 0) &&
-         (mOperativeMode == WCDLI_OPERATIVEMODE_COMMAND)))
+    if (ringCount(&ctx->txRing) == 0)
     {
-        command->name = mCurrentCommand;
-        *changeMode = TRUE;
-        return;
+        USART_DisableInterrupts(base,kUSART_TxLevelInterruptEnable);
     }
-    command->name = NULL;
-    return;
 }
-
-static void parseParams (void)
+#endif
+#elif defined (__NUECLIPSE)
+void WCDLI_callbackTx (UART_T* base, void* obj)
 {
-    // Buffer counter
-    uint8_t i = 0;
-    // Counter for each parameter
-    uint8_t j = 0;
-    // to know if double quote is for open or close
-    bool isStringOpen = FALSE;
+    WCDLI_Context_t* ctx = getContext(obj);
+    const uint8_t* data = NULL;
 
-    mNumberOfParams = 0;
+    while (!UART_IS_TX_FULL(base) && (ringPeek(&ctx->txRing,&data) > 0))
+    {
+        UART_WRITE(base,data[0]);
+        ringSkip(&ctx->txRing,1);
+    }
 
-    for (i = 0; i < (mCurrentCommandIndex -2); ++i)
+    if (ringCount(&ctx->txRing) == 0)
     {
-        if ((mCurrentCommand[i] != ' ') && (mCurrentCommand[i] != '\"'))
-        {
-            mParams[mNumberOfParams][j++] = mCurrentCommand[i];
-        }
-        else if ((mCurrentCommand[i] == '\"') && (isStringOpen == FALSE))
-        {
-            isStringOpen = TRUE;
-        }
-        else if ((mCurrentCommand[i] == '\"') && (isStringOpen == TRUE))
+        UART_DISABLE_INT(base,WCDLI_NUECLIPSE_TX_INTERRUPT);
+    }
+}
+#elif defined (__POSIX_HOST)
+/*!
+ * The bytes are moved to the peripheral FIFO, and leave the ring when they
+ * are written, as with the interrupts of the microcontrollers. The write is
+ * paced by the emulated baud rate.
+ */
+void WCDLI_callbackTx (WCDLI_HostDevice_t* base, void* obj)
+{
+    WCDLI_Context_t* ctx = getContext(obj);
+    uint8_t fifo[64];
+    const uint8_t* data = NULL;
+    uint16_t length = 0;
+    uint16_t tail = 0;
+    uint16_t dropped = 0;
+
+    for (;;)
+    {
+        WCDLI_ENTER_CRITICAL();
+        length = ringPeek(&ctx->txRing,&data);
+        if (length > sizeof(fifo))
         {
-            isStringOpen = FALSE;
-            mParams[mNumberOfParams][j] = '\0';
-            // The string parameter is at the end, reset the counter
-            j = 0;
-            // Increase the parameter number
-            mNumberOfParams++;
+            length = sizeof(fifo);
         }
-        else if ((mCurrentCommand[i] == ' ') && (isStringOpen == TRUE))
+        memcpy(fifo,data,length);
+        tail = ctx->txRing.tail;
+        WCDLI_EXIT_CRITICAL();
+
+        if (length == 0)
         {
-            mParams[mNumberOfParams][j++] = mCurrentCommand[i];
+            break;
         }
-        else if (((mCurrentCommand[i] == ' ') && (mCurrentCommand[i-1] == ' ')) ||
-                 ((mCurrentCommand[i] == ' ') && (mCurrentCommand[i-1] == '\"')))
+
+#if (WCDLI_HOST_BAUDRATE > 0)
+        usleep((useconds_t)((length * 10ull * 1000000ull) / WCDLI_HOST_BAUDRATE));
+#endif
+        hostWrite(base->tx,fifo,length);
+
+        // WCDLI_TXOVERFLOW_DROP_OLDEST may have just released some of them
+        WCDLI_ENTER_CRITICAL();
+        dropped = (ctx->txRing.tail >= tail) ? (ctx->txRing.tail - tail) :
+                                               (ctx->txRing.tail + ctx->txRing.size - tail);
+        if (dropped < length)
         {
-            continue;
+            ringSkip(&ctx->txRing,length - dropped);
         }
-        else
+        WCDLI_EXIT_CRITICAL();
+    }
+}
+
+static void* hostTxThread (void* obj)
+{
+    WCDLI_Context_t* ctx = obj;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&ctx->txMutex);
+        while (ctx->txPending == FALSE)
         {
-            mParams[mNumberOfParams][j] = '\0';
-            j = 0;
-            mNumberOfParams++;
+            pthread_cond_wait(&ctx->txEvent,&ctx->txMutex);
         }
+        ctx->txPending = FALSE;
+        pthread_mutex_unlock(&ctx->txMutex);
+
+        WCDLI_callbackTx(ctx->device,ctx);
     }
-    mParams[mNumberOfParams][j] = '\0';
-    mNumberOfParams++;
+    return NULL;
 }
+#endif
 
-_weak void WCDLI_printProjectVersion (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
+_weak void WCDLI_txStart (WCDLI_Context_t* ctx)
 {
-    char message[WCDLI_MAX_CHARS_PER_LINE] = {0};
-    bool isHello = false;
+#if defined (LIBOHIBOARD_VERSION)
+    // No TX interrupt hook: the ring is drained by WCDLI_ckeck()
+#elif defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+    UART_EnableInterrupts(ctx->device,kUART_TxDataRegEmptyInterruptEnable);
+#elif defined (__MCUXPRESSO_USART)
+    USART_EnableInterrupts(ctx->device,kUSART_TxLevelInterruptEnable);
+#endif
+#elif defined (__NUECLIPSE)
+    UART_ENABLE_INT(ctx->device,WCDLI_NUECLIPSE_TX_INTERRUPT);
+#elif defined (__POSIX_HOST)
+    pthread_mutex_lock(&ctx->txMutex);
+    ctx->txPending = TRUE;
+    pthread_cond_signal(&ctx->txEvent);
+    pthread_mutex_unlock(&ctx->txMutex);
+#endif
+}
 
-    if ((app == 0) && (argc == 0) && (argv == 0))
-    {
-        isHello = true;
+uint16_t WCDLI_txPeek_ex (WCDLI_Context_t* ctx, const uint8_t** data)
+{
+    return ringPeek(&ctx->txRing,data);
+}
+
+uint16_t WCDLI_txPeek (const uint8_t** data)
+{
+    return WCDLI_txPeek_ex(WCDLI_mainContext,data);
+}
+
+void WCDLI_txRelease_ex (WCDLI_Context_t* ctx, uint16_t length)
+{
+    ringSkip(&ctx->txRing,length);
+}
+
+void WCDLI_txRelease (uint16_t length)
+{
+    WCDLI_txRelease_ex(WCDLI_mainContext,length);
+}
+
+void WCDLI_setTxOverflowPolicy_ex (WCDLI_Context_t* ctx, WCDLI_TxOverflowPolicy_t policy)
+{
+    ctx->txOverflowPolicy = policy;
+}
+
+void WCDLI_setTxOverflowPolicy (WCDLI_TxOverflowPolicy_t policy)
+{
+    WCDLI_setTxOverflowPolicy_ex(WCDLI_mainContext,policy);
+}
+
+#if defined (LIBOHIBOARD_VERSION)
+/*!
+ * Drain the TX ring from the caller context, used when no interrupt drains
+ * the ring.
+ */
+static void drainTx (WCDLI_Context_t* ctx)
+{
+    const uint8_t* data = NULL;
+    uint16_t length = 0;
+
+    while ((length = ringPeek(&ctx->txRing,&data)) > 0)
+    {
+        Uart_writeBlocking(ctx,data,length);
+        ringSkip(&ctx->txRing,length);
+    }
+}
+#endif
+
+/*!
+ * Copy the bytes into the TX ring in a critical section: the debug APIs of
+ * every task are producers. With WCDLI_TXOVERFLOW_DROP_OLDEST the oldest
+ * bytes leave room for the new ones.
+ *
+ * \param[in] isWhole: TRUE to write nothing when the bytes do not fit, so a
+ *                     message is never mixed with the ones of other tasks.
+ * \return The bytes written.
+ */
+static uint16_t txWrite (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length, bool isWhole)
+{
+    uint16_t written = 0;
+
+    WCDLI_ENTER_CRITICAL();
+    if ((ctx->txOverflowPolicy == WCDLI_TXOVERFLOW_DROP_OLDEST) && (ringFree(&ctx->txRing) < length))
+    {
+        ringSkip(&ctx->txRing,length - ringFree(&ctx->txRing));
+    }
+    if ((isWhole == FALSE) || (ringFree(&ctx->txRing) >= length))
+    {
+        written = ringWrite(&ctx->txRing,data,length);
+    }
+    ctx->counters.txBytes += written;
+    WCDLI_EXIT_CRITICAL();
+    return written;
+}
+
+/*!
+ * Copy the bytes into the TX ring, applying the overflow policy when the
+ * ring is full, and start the drain. An interrupt handler cannot wait for
+ * the drain: there the blocking policy keeps only what fits.
+ */
+static void sendData (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length)
+{
+    uint16_t written = 0;
+    bool isWhole = FALSE;
+
+    if ((ctx->txOverflowPolicy == WCDLI_TXOVERFLOW_DROP_OLDEST) && (length > WCDLI_TX_BUFFER_DIMENSION))
+    {
+        // Only the tail of the message fits
+        data += (length - WCDLI_TX_BUFFER_DIMENSION);
+        length = WCDLI_TX_BUFFER_DIMENSION;
+    }
+
+    if ((ctx->txOverflowPolicy != WCDLI_TXOVERFLOW_BLOCK) || !WCDLI_CAN_WAIT_TX())
+    {
+        txWrite(ctx,data,length,FALSE);
+    }
+    else
+    {
+        // A message longer than the ring is written in pieces
+        isWhole = (length <= WCDLI_TX_BUFFER_DIMENSION);
+        while (written < length)
+        {
+            written += txWrite(ctx,&data[written],length - written,isWhole);
+            if (written < length)
+            {
+                uint32_t start = WCDLI_getCycles();
+                WCDLI_txStart(ctx);
+#if defined (LIBOHIBOARD_VERSION)
+                drainTx(ctx);
+#endif
+                ctx->counters.txBlockedCycles += WCDLI_getCycles() - start;
+            }
+        }
+    }
+
+    WCDLI_txStart(ctx);
+}
+
+static void flushTx (WCDLI_Context_t* ctx)
+{
+    uint32_t start = WCDLI_getCycles();
+
+#if defined (LIBOHIBOARD_VERSION)
+    drainTx(ctx);
+#else
+    WCDLI_txStart(ctx);
+    // From an interrupt handler the drain would never end
+    while (WCDLI_CAN_WAIT_TX() && (ringCount(&ctx->txRing) > 0))
+    {
+        // Wait the end of the drain
+    }
+#endif
+    ctx->counters.txBlockedCycles += WCDLI_getCycles() - start;
+}
+
+#else
+
+static inline void sendData (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length)
+{
+    uint32_t start = WCDLI_getCycles();
+
+    Uart_writeBlocking(ctx,data,length);
+    ctx->counters.txBytes += length;
+    ctx->counters.txBlockedCycles += WCDLI_getCycles() - start;
+}
+
+static inline void flushTx (WCDLI_Context_t* ctx)
+{
+    // Nothing to do: the writes are blocking
+    (void)ctx;
+}
+
+#endif // WCDLI_TX_BUFFER_DIMENSION
+
+_weak void WCDLI_setRxFlow (WCDLI_Context_t* ctx, bool isReady)
+{
+    // In binary mode XON and XOFF would be taken as packet bytes
+    if ((ctx->flowControl == WCDLI_FLOWCONTROL_XONXOFF) &&
+        (ctx->operativeMode != WCDLI_OPERATIVEMODE_BINARY))
+    {
+        uint8_t c = (isReady == TRUE) ? WCDLI_XON : WCDLI_XOFF;
+        Uart_writeBlocking(ctx,&c,1);
+    }
+#if defined (__POSIX_HOST)
+    ctx->device->isRxReady = isReady;
+#endif
+}
+
+/*!
+ * Restart the remote when the RX ring is drained, or when it holds only a
+ * part of a line, that can't be parsed without the rest.
+ */
+static void rxResume (WCDLI_Context_t* ctx)
+{
+    if ((ctx->isRxPaused == TRUE) &&
+        ((ringCount(&ctx->rxRing) <= WCDLI_RX_LOW_WATERMARK) || (ctx->rxHandled == ctx->rxEvents)))
+    {
+        // Restart before clearing the pause: a new pause of the interrupt comes after
+        WCDLI_setRxFlow(ctx,TRUE);
+        ctx->isRxPaused = FALSE;
+    }
+}
+
+void WCDLI_setFlowControl_ex (WCDLI_Context_t* ctx, WCDLI_FlowControl_t mode)
+{
+    if (ctx->isRxPaused == TRUE)
+    {
+        WCDLI_setRxFlow(ctx,TRUE);
+        ctx->isRxPaused = FALSE;
+    }
+    ctx->flowControl = mode;
+}
+
+void WCDLI_setFlowControl (WCDLI_FlowControl_t mode)
+{
+    WCDLI_setFlowControl_ex(WCDLI_mainContext,mode);
+}
+
+/*!
+ * Send the staged bytes as a single write.
+ */
+static void writeFlush (WCDLI_Context_t* ctx)
+{
+    if (ctx->outputIndex > 0)
+    {
+        sendData(ctx,ctx->output,ctx->outputIndex);
+        ctx->outputIndex = 0;
+    }
+}
+
+/*!
+ * Stage the bytes, and flush them when the policy asks for it.
+ */
+static void writeData (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length)
+{
+    bool isNewLine = FALSE;
+    uint16_t chunk = 0;
+
+    while (length > 0)
+    {
+        if (ctx->outputIndex == WCDLI_OUTPUT_BUFFER_DIMENSION)
+        {
+            writeFlush(ctx);
+        }
+
+        chunk = WCDLI_OUTPUT_BUFFER_DIMENSION - ctx->outputIndex;
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+        if ((ctx->outputFlushPolicy == WCDLI_OUTPUTFLUSH_ON_NEW_LINE) &&
+            (memchr(data,'\n',chunk) != NULL))
+        {
+            isNewLine = TRUE;
+        }
+
+        memcpy(&ctx->output[ctx->outputIndex],data,chunk);
+        ctx->outputIndex += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    if ((isNewLine == TRUE) ||
+        ((ctx->outputFlushPolicy == WCDLI_OUTPUTFLUSH_ON_THRESHOLD) &&
+         (ctx->outputIndex >= WCDLI_OUTPUT_FLUSH_THRESHOLD)))
+    {
+        writeFlush(ctx);
+    }
+}
+
+/*!
+ * Stage the same char many times, used for padding and dividing lines.
+ */
+static void writeChars (WCDLI_Context_t* ctx, char c, uint16_t count)
+{
+    uint16_t chunk = 0;
+
+    while (count > 0)
+    {
+        if (ctx->outputIndex == WCDLI_OUTPUT_BUFFER_DIMENSION)
+        {
+            writeFlush(ctx);
+        }
+
+        chunk = WCDLI_OUTPUT_BUFFER_DIMENSION - ctx->outputIndex;
+        if (chunk > count)
+        {
+            chunk = count;
+        }
+        memset(&ctx->output[ctx->outputIndex],c,chunk);
+        ctx->outputIndex += chunk;
+        count -= chunk;
+    }
+}
+
+static void writeString (WCDLI_Context_t* ctx, const char* text)
+{
+    writeData(ctx,(const uint8_t *)text,strlen(text));
+}
+
+static void writeStringln (WCDLI_Context_t* ctx, const char* text)
+{
+    writeData(ctx,(const uint8_t *)text,strlen(text));
+    writeData(ctx,(const uint8_t *)WCDLI_NEW_LINE,2);
+}
+
+/*!
+ * Destination of the formatter: the output of a console, or a buffer.
+ */
+typedef struct _WCDLI_FormatSink_t
+{
+    WCDLI_Context_t* ctx;        /*!< The console, NULL to write into the buffer */
+    char* buffer;
+    uint16_t size;               /*!< Dimension of the buffer, with the terminator */
+    uint16_t length;             /*!< Chars written into the buffer */
+    bool isTruncated;
+} WCDLI_FormatSink_t;
+
+#define WCDLI_FORMAT_FLAG_LEFT                   0x01u
+#define WCDLI_FORMAT_FLAG_ZERO                   0x02u
+#define WCDLI_FORMAT_FLAG_PLUS                   0x04u
+#define WCDLI_FORMAT_FLAG_SPACE                  0x08u
+#define WCDLI_FORMAT_FLAG_PRECISION              0x10u
+#define WCDLI_FORMAT_FLAG_ALTERNATE              0x20u
+
+/*!
+ * The digits of a 64 bit value, or of the fixed-point float, with its sign.
+ */
+#define WCDLI_FORMAT_DIGITS_SIZE                 32
+
+#if (WCDLI_FORMAT_FLOAT > 0)
+#define WCDLI_FORMAT_FLOAT_MAX_PRECISION         9
+#endif
+
+static void formatPut (WCDLI_FormatSink_t* sink, const char* data, uint16_t length)
+{
+    uint16_t room = 0;
+
+    if (sink->ctx != NULL)
+    {
+        writeData(sink->ctx,(const uint8_t*)data,length);
+        return;
+    }
+
+    room = sink->size - 1 - sink->length;
+    if (length > room)
+    {
+        sink->isTruncated = TRUE;
+        length = room;
+    }
+    memcpy(&sink->buffer[sink->length],data,length);
+    sink->length += length;
+}
+
+static void formatPad (WCDLI_FormatSink_t* sink, char c, uint16_t count)
+{
+    uint16_t room = 0;
+
+    if (sink->ctx != NULL)
+    {
+        writeChars(sink->ctx,c,count);
+        return;
+    }
+
+    room = sink->size - 1 - sink->length;
+    if (count > room)
+    {
+        sink->isTruncated = TRUE;
+        count = room;
+    }
+    memset(&sink->buffer[sink->length],c,count);
+    sink->length += count;
+}
+
+/*!
+ * Print a field: the sign or the prefix, the leading zeros and the body,
+ * padded to the width.
+ */
+static void formatField (WCDLI_FormatSink_t* sink,
+                         const char* prefix,
+                         uint16_t prefixLength,
+                         uint16_t zeros,
+                         const char* body,
+                         uint16_t bodyLength,
+                         uint16_t width,
+                         uint8_t flags)
+{
+    uint16_t length = prefixLength + zeros + bodyLength;
+    uint16_t padding = (width > length) ? (width - length) : 0;
+
+    if ((flags & WCDLI_FORMAT_FLAG_ZERO) && !(flags & WCDLI_FORMAT_FLAG_LEFT))
+    {
+        zeros += padding;
+        padding = 0;
+    }
+
+    if (!(flags & WCDLI_FORMAT_FLAG_LEFT))
+    {
+        formatPad(sink,' ',padding);
+    }
+    formatPut(sink,prefix,prefixLength);
+    formatPad(sink,'0',zeros);
+    formatPut(sink,body,bodyLength);
+    if (flags & WCDLI_FORMAT_FLAG_LEFT)
+    {
+        formatPad(sink,' ',padding);
+    }
+}
+
+/*!
+ * Write the digits of the value at the end of the buffer.
+ *
+ * \return The first digit.
+ */
+static char* formatUnsigned (char* end, uint64_t value, uint8_t base, bool isUpper)
+{
+    const char* digits = (isUpper == TRUE) ? "0123456789ABCDEF" : "0123456789abcdef";
+    uint32_t low = 0;
+
+    if (base == 16)
+    {
+        do
+        {
+            *--end = digits[value & 0x0Fu];
+            value >>= 4;
+        } while (value != 0);
+        return end;
+    }
+
+    // The 64 bit division is a library call on a 32 bit core
+    while (value > UINT32_MAX)
+    {
+        *--end = (char)('0' + (value % 10u));
+        value /= 10u;
+    }
+    low = (uint32_t)value;
+    do
+    {
+        *--end = (char)('0' + (low % 10u));
+        low /= 10u;
+    } while (low != 0);
+    return end;
+}
+
+#if (WCDLI_FORMAT_FLOAT > 0)
+/*!
+ * Write the fixed-point digits of the value at the end of the buffer.
+ *
+ * \return The first digit, or NULL when the value does not fit 64 bit.
+ */
+static char* formatFloat (char* end, double value, uint8_t precision)
+{
+    static const uint32_t scales[WCDLI_FORMAT_FLOAT_MAX_PRECISION + 1] =
+    {
+        1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+    };
+    uint64_t integer = 0;
+    uint32_t fraction = 0;
+    double rest = 0;
+
+    // NaN fails the comparison too
+    if (!(value < 18446744073709549568.0))
+    {
+        return NULL;
+    }
+
+    integer = (uint64_t)value;
+    rest = ((value - (double)integer) * scales[precision]) + 0.5;
+    fraction = (uint32_t)rest;
+    if (fraction >= scales[precision])
+    {
+        fraction -= scales[precision];
+        integer++;
+    }
+
+    for (uint8_t i = 0; i < precision; ++i)
+    {
+        *--end = (char)('0' + (fraction % 10u));
+        fraction /= 10u;
+    }
+    if (precision > 0)
+    {
+        *--end = '.';
+    }
+    return formatUnsigned(end,integer,10,FALSE);
+}
+#endif
+
+/*!
+ * The formatter of the messages. The literal text is copied by spans, and
+ * every conversion is printed straight into the sink, without an
+ * intermediate line.
+ */
+static void formatv (WCDLI_FormatSink_t* sink, const char* format, va_list argptr)
+{
+    char digits[WCDLI_FORMAT_DIGITS_SIZE];
+    char* const end = &digits[WCDLI_FORMAT_DIGITS_SIZE];
+    const char* percent = NULL;
+    const char* spec = NULL;
+    const char* body = NULL;
+    const char* prefix = "";
+    uint16_t prefixLength = 0;
+    uint16_t bodyLength = 0;
+    uint16_t zeros = 0;
+    uint16_t width = 0;
+    uint16_t precision = 0;
+    uint8_t flags = 0;
+    uint8_t size = 0;
+    uint64_t value = 0;
+    int64_t number = 0;
+    int star = 0;
+
+    while (*format != '\0')
+    {
+        percent = strchr(format,'%');
+        if (percent == NULL)
+        {
+            formatPut(sink,format,strlen(format));
+            return;
+        }
+        if (percent > format)
+        {
+            formatPut(sink,format,(uint16_t)(percent - format));
+        }
+
+        spec = percent;
+        format = percent + 1;
+        flags = 0;
+        width = 0;
+        precision = 0;
+        size = 0;
+        prefix = "";
+        prefixLength = 0;
+        zeros = 0;
+
+        // Flags
+        for (bool isFlag = TRUE; isFlag == TRUE; )
+        {
+            switch (*format)
+            {
+            case '-': flags |= WCDLI_FORMAT_FLAG_LEFT;      break;
+            case '0': flags |= WCDLI_FORMAT_FLAG_ZERO;      break;
+            case '+': flags |= WCDLI_FORMAT_FLAG_PLUS;      break;
+            case ' ': flags |= WCDLI_FORMAT_FLAG_SPACE;     break;
+            case '#': flags |= WCDLI_FORMAT_FLAG_ALTERNATE; break;
+            default:  isFlag = FALSE;                       continue;
+            }
+            format++;
+        }
+
+        // Width and precision
+        if (*format == '*')
+        {
+            star = va_arg(argptr,int);
+            if (star < 0)
+            {
+                flags |= WCDLI_FORMAT_FLAG_LEFT;
+                star = -star;
+            }
+            width = (uint16_t)star;
+            format++;
+        }
+        while ((*format >= '0') && (*format <= '9'))
+        {
+            width = (width * 10) + (*format++ - '0');
+        }
+        if (*format == '.')
+        {
+            flags |= WCDLI_FORMAT_FLAG_PRECISION;
+            format++;
+            if (*format == '*')
+            {
+                star = va_arg(argptr,int);
+                if (star < 0)
+                {
+                    // A negative precision is taken as omitted
+                    flags &= ~WCDLI_FORMAT_FLAG_PRECISION;
+                    star = 0;
+                }
+                precision = (uint16_t)star;
+                format++;
+            }
+            while ((*format >= '0') && (*format <= '9'))
+            {
+                precision = (precision * 10) + (*format++ - '0');
+            }
+        }
+
+        // Length: the size in bytes of the integer argument
+        switch (*format)
+        {
+        case 'h':
+            if (format[1] == 'h')
+            {
+                size = sizeof(char);
+                format += 2;
+            }
+            else
+            {
+                size = sizeof(short);
+                format++;
+            }
+            break;
+        case 'l':
+            if (format[1] == 'l')
+            {
+                size = sizeof(long long);
+                format += 2;
+            }
+            else
+            {
+                size = sizeof(long);
+                format++;
+            }
+            break;
+        case 'j':
+            size = sizeof(long long);
+            format++;
+            break;
+        case 'z':
+        case 't':
+            size = sizeof(size_t);
+            format++;
+            break;
+        default:
+            break;
+        }
+
+        switch (*format)
+        {
+        case 'd':
+        case 'i':
+            if (size == sizeof(long long))
+            {
+                number = va_arg(argptr,long long);
+            }
+            else if (size == sizeof(long))
+            {
+                number = va_arg(argptr,long);
+            }
+            else
+            {
+                number = va_arg(argptr,int);
+                number = (size == sizeof(char))  ? (signed char)number :
+                         (size == sizeof(short)) ? (short)number : number;
+            }
+            value = (number < 0) ? ((uint64_t)0 - (uint64_t)number) : (uint64_t)number;
+            prefix = (number < 0) ? "-" :
+                     (flags & WCDLI_FORMAT_FLAG_PLUS) ? "+" :
+                     (flags & WCDLI_FORMAT_FLAG_SPACE) ? " " : "";
+            prefixLength = (prefix[0] != '\0') ? 1 : 0;
+            body = formatUnsigned(end,value,10,FALSE);
+            break;
+
+        case 'u':
+        case 'x':
+        case 'X':
+            if (size == sizeof(long long))
+            {
+                value = va_arg(argptr,unsigned long long);
+            }
+            else if (size == sizeof(long))
+            {
+                value = va_arg(argptr,unsigned long);
+            }
+            else
+            {
+                value = va_arg(argptr,unsigned int);
+                value = (size == sizeof(char))  ? (unsigned char)value :
+                        (size == sizeof(short)) ? (unsigned short)value : value;
+            }
+            body = formatUnsigned(end,value,(*format == 'u') ? 10 : 16,(*format == 'X'));
+            if ((flags & WCDLI_FORMAT_FLAG_ALTERNATE) && (*format != 'u') && (value != 0))
+            {
+                prefix = (*format == 'X') ? "0X" : "0x";
+                prefixLength = 2;
+            }
+            break;
+
+        case 'p':
+            value = (uintptr_t)va_arg(argptr,void*);
+            prefix = "0x";
+            prefixLength = 2;
+            body = formatUnsigned(end,value,16,FALSE);
+            break;
+
+        case 's':
+            body = va_arg(argptr,const char*);
+            if (body == NULL)
+            {
+                body = "(null)";
+            }
+            bodyLength = 0;
+            while ((body[bodyLength] != '\0') &&
+                   (!(flags & WCDLI_FORMAT_FLAG_PRECISION) || (bodyLength < precision)))
+            {
+                bodyLength++;
+            }
+            formatField(sink,"",0,0,body,bodyLength,width,flags & WCDLI_FORMAT_FLAG_LEFT);
+            format++;
+            continue;
+
+        case 'c':
+            digits[0] = (char)va_arg(argptr,int);
+            formatField(sink,"",0,0,digits,1,width,flags & WCDLI_FORMAT_FLAG_LEFT);
+            format++;
+            continue;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        {
+            double real = va_arg(argptr,double);
+#if (WCDLI_FORMAT_FLOAT > 0)
+            if (!(flags & WCDLI_FORMAT_FLAG_PRECISION))
+            {
+                precision = 6;
+            }
+            else if (precision > WCDLI_FORMAT_FLOAT_MAX_PRECISION)
+            {
+                precision = WCDLI_FORMAT_FLOAT_MAX_PRECISION;
+            }
+            prefix = (real < 0) ? "-" :
+                     (flags & WCDLI_FORMAT_FLAG_PLUS) ? "+" :
+                     (flags & WCDLI_FORMAT_FLAG_SPACE) ? " " : "";
+            prefixLength = (prefix[0] != '\0') ? 1 : 0;
+            body = formatFloat(end,(real < 0) ? -real : real,(uint8_t)precision);
+            if (body != NULL)
+            {
+                bodyLength = (uint16_t)(end - body);
+            }
+            else
+            {
+                body = (real != real) ? "nan" : "inf";
+                bodyLength = 3;
+                flags &= ~WCDLI_FORMAT_FLAG_ZERO;
+            }
+            formatField(sink,prefix,prefixLength,0,body,bodyLength,width,flags);
+#else
+            (void)real;
+            formatPut(sink,spec,(uint16_t)(format + 1 - spec));
+#endif
+            format++;
+            continue;
+        }
+
+        case '%':
+            formatPut(sink,"%",1);
+            format++;
+            continue;
+
+        default:
+            // Not supported: printed as it is
+            if (*format == '\0')
+            {
+                formatPut(sink,spec,(uint16_t)(format - spec));
+                return;
+            }
+            formatPut(sink,spec,(uint16_t)(format + 1 - spec));
+            format++;
+            continue;
+        }
+
+        // The integer conversions: the precision is the minimum of digits
+        bodyLength = (uint16_t)(end - body);
+        if (flags & WCDLI_FORMAT_FLAG_PRECISION)
+        {
+            flags &= ~WCDLI_FORMAT_FLAG_ZERO;
+            if ((precision == 0) && (value == 0))
+            {
+                bodyLength = 0;
+            }
+            zeros = (precision > bodyLength) ? (precision - bodyLength) : 0;
+        }
+        formatField(sink,prefix,prefixLength,zeros,body,bodyLength,width,flags);
+        format++;
+    }
+}
+
+/*!
+ * Format straight into the output of the console.
+ */
+static void writeFormat (WCDLI_Context_t* ctx, const char* format, ...)
+{
+    WCDLI_FormatSink_t sink = {ctx, NULL, 0, 0, FALSE};
+    va_list argptr;
+
+    va_start(argptr,format);
+    formatv(&sink,format,argptr);
+    va_end(argptr);
+}
+
+/*!
+ * Format into the buffer, always terminated.
+ *
+ * \return FALSE when the text is truncated.
+ */
+static bool formatString (char* buffer, uint16_t size, const char* format, ...)
+{
+    WCDLI_FormatSink_t sink = {NULL, buffer, size, 0, FALSE};
+    va_list argptr;
+
+    va_start(argptr,format);
+    formatv(&sink,format,argptr);
+    va_end(argptr);
+    buffer[sink.length] = '\0';
+    return !sink.isTruncated;
+}
+
+#if !defined (LIBOHIBOARD_VERSION)
+static void Utility_getVersionString (const Utility_Version_t* version, char* toString)
+{
+    // The caller buffer is at least 32 chars
+    formatString(toString,32,"%u.%u.%u of ",
+                 (unsigned int)version->f.major,
+                 (unsigned int)version->f.minor,
+                 (unsigned int)version->f.subminor);
+
+    //Time_unixtimeToString(version->f.time,tmp2);
+}
+#endif
+
+void WCDLI_flush_ex (WCDLI_Context_t* ctx)
+{
+    writeFlush(ctx);
+    flushTx(ctx);
+}
+
+void WCDLI_flush (void)
+{
+    WCDLI_flush_ex(WCDLI_mainContext);
+}
+
+void WCDLI_openResponse_ex (WCDLI_Context_t* ctx)
+{
+    ctx->isResponseOpen = TRUE;
+}
+
+void WCDLI_openResponse (void)
+{
+    WCDLI_openResponse_ex(commandContext());
+}
+
+uint16_t WCDLI_writeResponse_ex (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length)
+{
+#if (WCDLI_TX_BUFFER_DIMENSION > 0)
+    uint16_t written = 0;
+
+    // The staged bytes go first, and whole
+    if (ctx->outputIndex > 0)
+    {
+        if (ringFree(&ctx->txRing) < ctx->outputIndex)
+        {
+            WCDLI_txStart(ctx);
+            return 0;
+        }
+        writeFlush(ctx);
+    }
+
+    written = txWrite(ctx,data,length,FALSE);
+    WCDLI_txStart(ctx);
+    return written;
+#else
+    // Blocking writes: everything is accepted
+    writeData(ctx,data,length);
+    writeFlush(ctx);
+    return length;
+#endif
+}
+
+uint16_t WCDLI_writeResponse (const uint8_t* data, uint16_t length)
+{
+    return WCDLI_writeResponse_ex(commandContext(),data,length);
+}
+
+void WCDLI_closeResponse_ex (WCDLI_Context_t* ctx)
+{
+    ctx->isResponseOpen = FALSE;
+
+    if ((ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND) && (ctx->isBatch == FALSE) &&
+        (ctx->isRunning == FALSE))
+    {
+        prompt(ctx);
+    }
+    else
+    {
+        writeFlush(ctx);
+    }
+
+    // The lines received meanwhile can be parsed
+    WCDLI_signal(ctx);
+}
+
+void WCDLI_closeResponse (void)
+{
+    WCDLI_closeResponse_ex(commandContext());
+}
+
+void WCDLI_setOutputFlushPolicy_ex (WCDLI_Context_t* ctx, WCDLI_OutputFlushPolicy_t policy)
+{
+    ctx->outputFlushPolicy = policy;
+    writeFlush(ctx);
+}
+
+void WCDLI_setOutputFlushPolicy (WCDLI_OutputFlushPolicy_t policy)
+{
+    WCDLI_setOutputFlushPolicy_ex(WCDLI_mainContext,policy);
+}
+
+/*!
+ * Print a line of the help: name and description are aligned in columns.
+ *
+ * \param[in] indentation: Number of blanks before the name.
+ */
+static void printHelpLine (WCDLI_Context_t* ctx, uint8_t indentation, const char* name, const char* description)
+{
+    uint16_t length = indentation + strlen(name);
+
+    writeChars(ctx,' ',indentation);
+    writeString(ctx,name);
+    if (length < WCDLI_MAX_CHARS_COMMAND_LINE)
+    {
+        writeChars(ctx,' ',WCDLI_MAX_CHARS_COMMAND_LINE - length);
+    }
+    writeChars(ctx,WCDLI_DIVIDING_DESCRIPTION_CHAR,1);
+    writeChars(ctx,' ',1);
+    writeStringln(ctx,description);
+}
+
+static void resetBuffer (WCDLI_Context_t* ctx)
+{
+    ctx->currentCommandIndex = 0;
+}
+
+static void prompt (WCDLI_Context_t* ctx)
+{
+    resetBuffer(ctx);
+    writeString(ctx,mPromptString);
+    writeFlush(ctx);
+}
+
+static void printLibraryVersion (WCDLI_Context_t* ctx)
+{
+    char versionString[64] = {0};
+
+#if !defined (LIBOHIBOARD_VERSION)
+    static const Utility_Version_t WCDLI_FIRMWARE_VERSION =
+    {
+        {
+            WARCOMEB_WCDLI_LIBRARY_VERSION_MAJOR,
+            WARCOMEB_WCDLI_LIBRARY_VERSION_MINOR,
+            WARCOMEB_WCDLI_LIBRARY_VERSION_BUG,
+            WARCOMEB_WCDLI_LIBRARY_TIME
+        }
+    };
+#endif
+    Utility_getVersionString(&WCDLI_FIRMWARE_VERSION,versionString);
+
+    writeFormat(ctx,"%s : %s" WCDLI_NEW_LINE,WCDLI_PROJECT_NAME,versionString);
+}
+
+static void sayHello (WCDLI_Context_t* ctx)
+{
+    WCDLI_PRINT_NEW_LINE(ctx);
+    WCDLI_PRINT_DIVIDING_LINE(ctx);
+    WCDLI_PRINT_NEW_LINE(ctx);
+
+    printLibraryVersion(ctx);
+
+    WCDLI_PRINT_DIVIDING_LINE(ctx);
+    WCDLI_PRINT_NEW_LINE(ctx);
+
+#if (defined (PROJECT_NAME) || defined (PROJECT_COPYRIGTH))
+#if defined (PROJECT_NAME)
+    writeStringln(ctx,PROJECT_NAME);
+#endif
+#if defined (PROJECT_COPYRIGTH)
+    writeStringln(ctx,PROJECT_COPYRIGTH);
+#endif
+    WCDLI_PRINT_DIVIDING_LINE(ctx);
+    WCDLI_PRINT_NEW_LINE(ctx);
+#endif
+
+    // Printed as an answer of this console
+    mCurrentContext = ctx;
+    WCDLI_printProjectVersion(0,0,0);
+    mCurrentContext = NULL;
+    WCDLI_PRINT_DIVIDING_LINE(ctx);
+    WCDLI_PRINT_NEW_LINE(ctx);
+}
+
+static void reboot (void* app, int argc, const char* argv[])
+{
+    WCDLI_PRINT_CMD_MESSAGE("Reboot...");
+    NVIC_SystemReset();
+}
+
+static void help (void* app, int argc, const char* argv[])
+{
+    WCDLI_Context_t* ctx = commandContext();
+
+    for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; ++i)
+    {
+        printHelpLine(ctx,0,mCommands[i].name,mCommands[i].description);
+    }
+
+    for (uint8_t i = 0; i < mExternalCommandsIndex; ++i)
+    {
+        printHelpLine(ctx,0,mExternalCommands[i].name,mExternalCommands[i].description);
+    }
+
+    for (uint8_t i = 0; i < mExternalAppsIndex; ++i)
+    {
+        printHelpLine(ctx,0,mExternalApps[i].name,mExternalApps[i].description);
+
+        // The app prints its own help lines
+        if (mExternalApps[i].argvCallback != NULL)
+        {
+            mExternalApps[i].argvCallback(mExternalApps[i].device,1,0);
+        }
+        else if (mExternalApps[i].callback != NULL)
+        {
+            mExternalApps[i].callback(mExternalApps[i].device,1,0);
+        }
+    }
+
+    WCDLI_PRINT_NEW_LINE(ctx);
+}
+
+#if (WCDLI_PROFILING > 0)
+/*!
+ * \return The profile of a command of the tables, NULL otherwise.
+ */
+static WCDLI_CommandStats_t* findStats (const WCDLI_Command_t* command)
+{
+    if ((command >= mCommands) && (command < &mCommands[WCDLI_COMMANDS_SIZE]))
+    {
+        return &mCommandsStats[command - mCommands];
+    }
+    if ((command >= mExternalCommands) && (command < &mExternalCommands[WCDLI_MAX_EXTERNAL_COMMAND]))
+    {
+        return &mExternalCommandsStats[command - mExternalCommands];
+    }
+    if ((command >= mExternalApps) && (command < &mExternalApps[WCDLI_MAX_EXTERNAL_APP]))
+    {
+        return &mExternalAppsStats[command - mExternalApps];
+    }
+    return NULL;
+}
+
+static void profileRecord (WCDLI_CommandStats_t* stats, uint32_t cycles)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+    if ((stats->calls == 0) || (cycles < stats->min))
+    {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max)
+    {
+        stats->max = cycles;
+    }
+    stats->total += cycles;
+    stats->calls++;
+}
+
+static void printStatsLine (WCDLI_Context_t* ctx, const char* name, const WCDLI_CommandStats_t* stats)
+{
+    if (stats->calls == 0)
+    {
+        return;
+    }
+
+    writeFormat(ctx,"%-12.12s %8lu %10lu %10lu %10lu %12lu" WCDLI_NEW_LINE,name,
+                (unsigned long)stats->calls,
+                (unsigned long)stats->min,
+                (unsigned long)(stats->total / stats->calls),
+                (unsigned long)stats->max,
+                (unsigned long)(stats->total / 1000u));
+}
+
+static void printStats (void* app, uint8_t argc, const WCDLI_ArgValue_t argv[])
+{
+    WCDLI_Context_t* ctx = commandContext();
+
+    // The only action is reset
+    if (argv[0].isSet == TRUE)
+    {
+        memset(mCommandsStats,0,sizeof(mCommandsStats));
+        memset(mExternalCommandsStats,0,sizeof(mExternalCommandsStats));
+        memset(mExternalAppsStats,0,sizeof(mExternalAppsStats));
+        WCDLI_PRINT_SUCCESS();
+        return;
+    }
+
+    writeFormat(ctx,"%-12s %8s %10s %10s %10s %12s" WCDLI_NEW_LINE,
+                "Command","Calls","Min","Mean","Max","Total/1000");
+    writeString(ctx,"Unit: ");
+    writeStringln(ctx,WCDLI_CYCLES_UNIT);
+
+    for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; ++i)
+    {
+        printStatsLine(ctx,mCommands[i].name,&mCommandsStats[i]);
+    }
+    for (uint8_t i = 0; i < mExternalCommandsIndex; ++i)
+    {
+        printStatsLine(ctx,mExternalCommands[i].name,&mExternalCommandsStats[i]);
+    }
+    for (uint8_t i = 0; i < mExternalAppsIndex; ++i)
+    {
+        printStatsLine(ctx,mExternalApps[i].name,&mExternalAppsStats[i]);
+    }
+
+    WCDLI_PRINT_NEW_LINE(ctx);
+}
+#endif
+
+/*!
+ * \param[in]    text: The level as a single digit.
+ * \param[out] level:
+ * \return FALSE when the text is not a valid level.
+ */
+static bool parseDebugLevel (const char* text, WCDLI_MessageLevel_t* level)
+{
+    if ((strlen(text) == 1) && (text[0] >= '1') && (text[0] <= '6'))
+    {
+        *level = (WCDLI_MessageLevel_t)(text[0] - '0');
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static bool findModule (const char* name, WCDLI_Module_t* module)
+{
+    for (uint8_t i = 0; i < mModulesSize; ++i)
+    {
+        if (strcmp(mModuleNames[i],name) == 0)
+        {
+            *module = i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void manageDebugLevel (void* app, int argc, const char* argv[])
+{
+    WCDLI_MessageLevel_t level = WCDLI_MESSAGELEVEL_NONE;
+    WCDLI_Module_t module = 0;
+
+    if ((argc == 2) && (strcmp(&argv[1][0],"?") == 0))
+    {
+        WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_NONE,"Current debug level is %d\r\n",WCDLI_debugLevel);
+        return;
+    }
+
+    if ((argc == 2) && (parseDebugLevel(&argv[1][0],&level) == TRUE))
+    {
+        WCDLI_debugLevel = level;
+        WCDLI_PRINT_SUCCESS();
+        return;
+    }
+
+    if ((argc == 2) && (strcmp(&argv[1][0],"list") == 0))
+    {
+        for (uint8_t i = 0; i < mModulesSize; ++i)
+        {
+            WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_NONE,"%s: %d\r\n",mModuleNames[i],WCDLI_moduleLevels[i]);
+        }
+        return;
+    }
+
+    if ((argc == 3) && (findModule(&argv[1][0],&module) == TRUE))
+    {
+        if (strcmp(&argv[2][0],"?") == 0)
+        {
+            WCDLI_debugByFormat(WCDLI_MESSAGELEVEL_NONE,"Current %s debug level is %d\r\n",
+                                mModuleNames[module],WCDLI_moduleLevels[module]);
+            return;
+        }
+
+        if (parseDebugLevel(&argv[2][0],&level) == TRUE)
+        {
+            WCDLI_moduleLevels[module] = level;
+            WCDLI_PRINT_SUCCESS();
+            return;
+        }
+    }
+
+    // Send wrong command message!
+    WCDLI_PRINT_WRONG_COMMAND();
+}
+
+#if defined (LIBOHIBOARD_RTC)
+static void setTime (void* app, uint8_t argc, const WCDLI_ArgValue_t argv[])
+{
+    Rtc_setTime(OB_RTC0, argv[0].as.u);
+}
+
+static void getTime (void* app, int argc, const char* argv[])
+{
+    // TODO
+    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+}
+#endif
+
+_weak void WCDLI_save (void* app, int argc, const char* argv[])
+{
+    // TODO
+    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+}
+
+static inline bool isCommandNameEnd (char c)
+{
+    return ((c == '\0') || (c == ' ') || (c == '\r') || (c == '\n'));
+}
+
+/*!
+ * FNV-1a hash of the command name, the name ends with the first space or
+ * line terminator.
+ *
+ * \param[in]   name: The command name.
+ * \param[in]   seed: The seed of the hash function.
+ * \param[out] length: The length of the command name.
+ * \return The slot of the hash index.
+ */
+static inline uint8_t hashCommandName (const char* name, uint32_t seed, uint8_t* length)
+{
+    uint32_t hash = 2166136261ul ^ (seed * 16777619ul);
+    uint8_t i = 0;
+
+    while (!isCommandNameEnd(name[i]))
+    {
+        hash ^= (uint8_t)name[i++];
+        hash *= 16777619ul;
+    }
+    *length = i;
+    return (uint8_t)((hash ^ (hash >> 16)) & (WCDLI_COMMANDS_HASH_SIZE - 1));
+}
+
+/*!
+ * Build the hash index of the static commands table. All the seeds are tried
+ * until no collision is found; otherwise the index falls back to linear
+ * probing with the first seed.
+ */
+static void buildCommandsHash (void)
+{
+    uint8_t length = 0;
+    uint8_t slot = 0;
+    uint32_t seed = 0;
+
+    // The values of a schema are parsed into WCDLI_MAX_PARAMS slots, as
+    // addExternal() checks for the added commands
+    for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; ++i)
+    {
+        if ((mCommands[i].schema != NULL) && (mCommands[i].schema->count > WCDLI_MAX_PARAMS))
+        {
+#if defined (LIBOHIBOARD_VERSION)
+            ohiassert(0);
+#else
+            assert(0);
+#endif
+        }
+    }
+
+    for (seed = 0; seed < WCDLI_COMMANDS_HASH_MAX_SEED; ++seed)
+    {
+        memset(mCommandsHash,0,sizeof(mCommandsHash));
+        mCommandsHashIsPerfect = TRUE;
+
+        for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; ++i)
+        {
+            slot = hashCommandName(mCommands[i].name,seed,&length);
+            if (mCommandsHash[slot] != 0)
+            {
+                mCommandsHashIsPerfect = FALSE;
+                break;
+            }
+            mCommandsHash[slot] = i + 1;
+        }
+
+        if (mCommandsHashIsPerfect == TRUE)
+        {
+            mCommandsHashSeed = seed;
+            return;
+        }
+    }
+
+    // No perfect seed: use linear probing
+    memset(mCommandsHash,0,sizeof(mCommandsHash));
+    mCommandsHashSeed = 0;
+    for (uint8_t i = 0; i < WCDLI_COMMANDS_SIZE; ++i)
+    {
+        slot = hashCommandName(mCommands[i].name,0,&length);
+        // The probes are bounded, even if the size check is the build one
+        for (uint16_t probe = 0; (probe < WCDLI_COMMANDS_HASH_SIZE) && (mCommandsHash[slot] != 0); ++probe)
+        {
+            slot = (slot + 1) & (WCDLI_COMMANDS_HASH_SIZE - 1);
+        }
+        if (mCommandsHash[slot] == 0)
+        {
+            mCommandsHash[slot] = i + 1;
+        }
+    }
+}
+
+/*!
+ * Search a static command by its whole name.
+ *
+ * \param[in] name: The first token of the current line.
+ * \return The command descriptor, NULL when not found.
+ */
+static const WCDLI_Command_t* findCommand (const char* name)
+{
+    uint8_t length = 0;
+    uint8_t slot = hashCommandName(name,mCommandsHashSeed,&length);
+
+    for (uint16_t probe = 0; probe < WCDLI_COMMANDS_HASH_SIZE; ++probe)
+    {
+        if (mCommandsHash[slot] == 0)
+        {
+            return NULL;
+        }
+
+        const WCDLI_Command_t* command = &mCommands[mCommandsHash[slot] - 1];
+        if ((strncmp(command->name,name,length) == 0) && (command->name[length] == '\0'))
+        {
+            return command;
+        }
+
+        if (mCommandsHashIsPerfect == TRUE)
+        {
+            return NULL;
+        }
+        slot = (slot + 1) & (WCDLI_COMMANDS_HASH_SIZE - 1);
+    }
+    return NULL;
+}
+
+static uint8_t findIndexChild (uint8_t node, char c)
+{
+    uint8_t child = mIndexNodes[node].child;
+
+    while ((child != 0) && (mIndexNodes[child].label[0] != c))
+    {
+        child = mIndexNodes[child].sibling;
+    }
+    return child;
+}
+
+static uint8_t addIndexNode (const char* label,
+                             uint8_t length,
+                             const WCDLI_Command_t* command)
+{
+    uint8_t node = mIndexNodesSize++;
+
+    mIndexNodes[node].label   = label;
+    mIndexNodes[node].length  = length;
+    mIndexNodes[node].child   = 0;
+    mIndexNodes[node].sibling = 0;
+    mIndexNodes[node].command = command;
+    return node;
+}
+
+/*!
+ * Insert a command into the radix-trie index.
+ *
+ * \param[in] command: The registered command, its name must not be empty.
+ * \return WCDLI_ERROR_DUPLICATED_NAME when the name is just registered.
+ */
+static WCDLI_Error_t insertIndex (const WCDLI_Command_t* command)
+{
+    const char* name = command->name;
+    uint8_t node = 0;
+    uint8_t child = 0;
+    uint8_t common = 0;
+
+    while (*name != '\0')
+    {
+        child = findIndexChild(node,*name);
+
+        if (child == 0)
+        {
+            // New leaf: add it as first child
+            child = addIndexNode(name,strlen(name),command);
+            mIndexNodes[child].sibling = mIndexNodes[node].child;
+            mIndexNodes[node].child = child;
+            return WCDLI_ERROR_SUCCESS;
+        }
+
+        common = 1;
+        while ((common < mIndexNodes[child].length) &&
+               (mIndexNodes[child].label[common] == name[common]))
+        {
+            common++;
+        }
+
+        if (common < mIndexNodes[child].length)
+        {
+            // Split the edge: the tail of the label becomes the only child
+            uint8_t tail = addIndexNode(&mIndexNodes[child].label[common],
+                                        mIndexNodes[child].length - common,
+                                        mIndexNodes[child].command);
+            mIndexNodes[tail].child     = mIndexNodes[child].child;
+            mIndexNodes[child].length   = common;
+            mIndexNodes[child].child    = tail;
+            mIndexNodes[child].command  = NULL;
+        }
+
+        node = child;
+        name += common;
+    }
+
+    if (mIndexNodes[node].command != NULL)
+    {
+        return WCDLI_ERROR_DUPLICATED_NAME;
+    }
+    mIndexNodes[node].command = command;
+    return WCDLI_ERROR_SUCCESS;
+}
+
+/*!
+ * Count the commands reachable from a node, stopping at two.
+ */
+static uint8_t countIndexCommands (uint8_t node)
+{
+    uint8_t count = (mIndexNodes[node].command != NULL) ? 1 : 0;
+
+    for (uint8_t child = mIndexNodes[node].child;
+         (child != 0) && (count < 2);
+         child = mIndexNodes[child].sibling)
+    {
+        count += countIndexCommands(child);
+    }
+    return count;
+}
+
+/*!
+ * Search a runtime-registered command or app by its whole name.
+ *
+ * \param[in]         name: The first token of the current line.
+ * \param[out] isAmbiguous: TRUE when the name is not registered but it is the
+ *                          prefix of more than one registered name.
+ * \return The command descriptor, NULL when not found.
+ */
+static const WCDLI_Command_t* findIndex (const char* name, bool* isAmbiguous)
+{
+    uint8_t node = 0;
+    uint8_t i = 0;
+
+    *isAmbiguous = FALSE;
+
+    while (!isCommandNameEnd(*name))
+    {
+        node = findIndexChild(node,*name);
+        if (node == 0)
+        {
+            return NULL;
+        }
+
+        for (i = 1; i < mIndexNodes[node].length; ++i)
+        {
+            if (mIndexNodes[node].label[i] != name[i])
+            {
+                *isAmbiguous = (isCommandNameEnd(name[i]) && (countIndexCommands(node) > 1));
+                return NULL;
+            }
+        }
+        name += i;
+    }
+
+    if (mIndexNodes[node].command == NULL)
+    {
+        *isAmbiguous = (countIndexCommands(node) > 1);
+    }
+    return mIndexNodes[node].command;
+}
+
+/*!
+ * \param[in]         line: The command, up to the end of its arguments.
+ * \param[out]     command:
+ * \param[out]  changeMode:
+ * \param[out] isAmbiguous: TRUE when the command name is the prefix of more
+ *                          than one registered name.
+ * \return The entry of the command into its table, NULL otherwise.
+ */
+static const WCDLI_Command_t* parseCommand (WCDLI_Context_t* ctx, const char* line, WCDLI_Command_t* command, bool* changeMode, bool* isAmbiguous)
+{
+    *isAmbiguous = FALSE;
+
+    if (ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND)
+    {
+        const WCDLI_Command_t* found = findCommand(line);
+        if (found != NULL)
+        {
+            command->name        = found->name;
+            command->description = found->description;
+            command->callback    = found->callback;
+            command->argvCallback = found->argvCallback;
+            command->binaryCallback = found->binaryCallback;
+            command->resumableCallback = found->resumableCallback;
+            command->schema      = found->schema;
+            command->device      = 0;
+
+            *changeMode = FALSE;
+            return found;
+        }
+
+        found = findIndex(line,isAmbiguous);
+        if (found != NULL)
+        {
+            command->name        = found->name;
+            command->description = found->description;
+            command->callback    = found->callback;
+            command->argvCallback = found->argvCallback;
+            command->binaryCallback = found->binaryCallback;
+            command->resumableCallback = found->resumableCallback;
+            command->schema      = found->schema;
+            command->device      = found->device;
+
+            *changeMode = FALSE;
+            return found;
+        }
+    }
+
+    if (((strncmp(line, WCDLI_ENTER_COMMAND_MODE, strlen(WCDLI_ENTER_COMMAND_MODE)) == 0) &&
+         (ctx->operativeMode == WCDLI_OPERATIVEMODE_DEBUG)) ||
+        ((strncmp(line, WCDLI_ENTER_DEBUG_MODE, strlen(WCDLI_ENTER_DEBUG_MODE)) == 0) &&
+         (ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND)) ||
+        (strncmp(line, WCDLI_ENTER_BINARY_MODE, strlen(WCDLI_ENTER_BINARY_MODE)) == 0))
+    {
+        command->name = line;
+        *changeMode = TRUE;
+        return NULL;
+    }
+    command->name = NULL;
+    return NULL;
+}
+
+/*!
+ * Split a command in place: the separators and the quotes become string
+ * terminators and params points to the start of every argument. Spaces are
+ * kept inside the double quotes; the arguments over WCDLI_MAX_PARAMS are
+ * ignored.
+ *
+ * \param[in]   c: The command.
+ * \param[in] end: The terminator of the command.
+ */
+static void parseParams (WCDLI_Context_t* ctx, char* c, char* const end)
+{
+    ctx->numberOfParams = 0;
+
+    while (c < end)
+    {
+        // Skip the separators
+        if (*c == ' ')
+        {
+            c++;
+            continue;
+        }
+
+        if (*c == '\"')
+        {
+            // The argument is the quoted string, without quotes: the opening
+            // quote ends an argument glued to it
+            *c++ = '\0';
+            if (ctx->numberOfParams < WCDLI_MAX_PARAMS)
+            {
+                ctx->params[ctx->numberOfParams++] = c;
+            }
+            while ((c < end) && (*c != '\"'))
+            {
+                c++;
+            }
+        }
+        else
+        {
+            if (ctx->numberOfParams < WCDLI_MAX_PARAMS)
+            {
+                ctx->params[ctx->numberOfParams++] = c;
+            }
+            while ((c < end) && (*c != ' ') && (*c != '\"'))
+            {
+                c++;
+            }
+            // A quote glued to the argument opens the next one
+            if (*c == '\"')
+            {
+                continue;
+            }
+        }
+        *c++ = '\0';
+    }
+}
+
+/*!
+ * Append a span without backspaces to the current command. When the line is
+ * too long the tail is truncated, keeping the last two chars for the end of
+ * line detection.
+ */
+static inline void appendLine (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length)
+{
+    char* line = ctx->currentCommand;
+    uint16_t chunk = WCDLI_MAX_CHARS_PER_LINE - ctx->currentCommandIndex;
+
+    if (chunk > length)
+    {
+        chunk = length;
+    }
+    memcpy(&line[ctx->currentCommandIndex],data,chunk);
+    ctx->currentCommandIndex += chunk;
+    data += chunk;
+    length -= chunk;
+
+    if (length == 1)
+    {
+        line[WCDLI_MAX_CHARS_PER_LINE-2] = line[WCDLI_MAX_CHARS_PER_LINE-1];
+        line[WCDLI_MAX_CHARS_PER_LINE-1] = data[0];
+    }
+    else if (length > 1)
+    {
+        line[WCDLI_MAX_CHARS_PER_LINE-2] = data[length-2];
+        line[WCDLI_MAX_CHARS_PER_LINE-1] = data[length-1];
+    }
+}
+
+/*!
+ * Move the received bytes into the current command until the end of a line.
+ * The contiguous spans of the RX ring are searched with memchr for the line
+ * feed and the backspaces, and copied with a single move.
+ *
+ * \return TRUE when the current command is a complete line, ended by "\r\n".
+ */
+static bool frameLine (WCDLI_Context_t* ctx)
+{
+    const uint8_t* span = NULL;
+    const uint8_t* lf = NULL;
+    const uint8_t* bs = NULL;
+    uint16_t length = 0;
+    uint16_t chunk = 0;
+    uint16_t consumed = 0;
+
+    while ((length = ringPeek(&ctx->rxRing,&span)) > 0)
+    {
+        lf = memchr(span,'\n',length);
+        chunk = (lf != NULL) ? (uint16_t)(lf + 1 - span) : length;
+        consumed = chunk;
+
+        // Ctrl-C drops the line typed so far
+        while ((bs = memchr(span,WCDLI_CANCEL_CHAR,chunk)) != NULL)
+        {
+            ctx->currentCommandIndex = 0;
+            chunk -= (bs + 1 - span);
+            span = bs + 1;
+        }
+
+        // Use the back space for delete char
+        while ((bs = memchr(span,'\b',chunk)) != NULL)
+        {
+            appendLine(ctx,span,bs - span);
+            if (ctx->currentCommandIndex > 0)
+            {
+                ctx->currentCommandIndex--;
+            }
+            chunk -= (bs + 1 - span);
+            span = bs + 1;
+        }
+        appendLine(ctx,span,chunk);
+
+        // The span is released only when read: the RX interrupt writes there
+        ringSkip(&ctx->rxRing,consumed);
+
+        if ((lf != NULL) &&
+            (ctx->currentCommandIndex >= 2) &&
+            (ctx->currentCommand[ctx->currentCommandIndex-2] == '\r') &&
+            (ctx->currentCommand[ctx->currentCommandIndex-1] == '\n'))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * Enter the mode asked by the escape sequence of the current command.
+ */
+static void changeOperativeMode (WCDLI_Context_t* ctx, const char* line)
+{
+    if (strncmp(line,WCDLI_ENTER_COMMAND_MODE,strlen(WCDLI_ENTER_COMMAND_MODE)) == 0)
+    {
+        ctx->operativeMode = WCDLI_OPERATIVEMODE_COMMAND;
+    }
+    else if (strncmp(line,WCDLI_ENTER_DEBUG_MODE,strlen(WCDLI_ENTER_DEBUG_MODE)) == 0)
+    {
+        ctx->operativeMode = WCDLI_OPERATIVEMODE_DEBUG;
+#if (WCDLI_LOG_TIMESTAMP > 0)
+        // The first message has the absolute time
+        ctx->logTimestampSync = 0;
+#endif
+    }
+    else
+    {
+        // The remote terminal waits this line before sending packets
+        writeStringln(ctx,"Binary mode");
+        writeFlush(ctx);
+        ctx->rxLength = 0;
+        ctx->operativeMode = WCDLI_OPERATIVEMODE_BINARY;
+    }
+}
+
+/*!
+ * CRC-16/CCITT-FALSE, a nibble at a time.
+ */
+static uint16_t crc16 (const uint8_t* data, uint16_t length)
+{
+    static const uint16_t table[16] =
+    {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFFu;
+
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0Fu)];
+    }
+    return crc;
+}
+
+/*!
+ * Decode a COBS packet in place, the delimiter is just removed.
+ *
+ * \return The decoded length, zero when the packet is wrong.
+ */
+static uint16_t cobsDecode (uint8_t* data, uint16_t length)
+{
+    uint16_t read = 0;
+    uint16_t written = 0;
+    uint8_t code = 0;
+
+    while (read < length)
+    {
+        code = data[read++];
+        if ((code == 0) || ((read + code - 1) > length))
+        {
+            return 0;
+        }
+        // The decoded bytes never pass the encoded ones
+        memmove(&data[written],&data[read],code - 1);
+        written += code - 1;
+        read += code - 1;
+
+        if ((code < 0xFFu) && (read < length))
+        {
+            data[written++] = 0;
+        }
+    }
+    return written;
+}
+
+/*!
+ * \param[out] encoded: Room for length + (length / 254) + 2 bytes.
+ * \return The encoded length, delimiter included.
+ */
+static uint16_t cobsEncode (const uint8_t* data, uint16_t length, uint8_t* encoded)
+{
+    uint16_t code = 0;
+    uint16_t written = 1;
+    uint8_t run = 1;
+
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        if (data[i] != 0)
+        {
+            encoded[written++] = data[i];
+            run++;
+        }
+        if ((data[i] == 0) || (run == 0xFFu))
+        {
+            encoded[code] = run;
+            code = written++;
+            run = 1;
+        }
+    }
+    encoded[code] = run;
+    encoded[written++] = WCDLI_BINARY_DELIMITER;
+    return written;
+}
+
+/*!
+ * Move the received bytes into the current command until the delimiter of a
+ * packet. A packet longer than the line buffer is discarded whole.
+ *
+ * \return TRUE when a packet is ended: a discarded packet has
+ *         currentCommandIndex greater than WCDLI_MAX_CHARS_PER_LINE.
+ */
+static bool frameBinary (WCDLI_Context_t* ctx)
+{
+    const uint8_t* span = NULL;
+    const uint8_t* end = NULL;
+    uint16_t length = 0;
+    uint16_t chunk = 0;
+
+    while ((length = ringPeek(&ctx->rxRing,&span)) > 0)
+    {
+        end = memchr(span,WCDLI_BINARY_DELIMITER,length);
+        chunk = (end != NULL) ? (uint16_t)(end - span) : length;
+
+        if ((ctx->currentCommandIndex + chunk) <= WCDLI_MAX_CHARS_PER_LINE)
+        {
+            memcpy(&ctx->currentCommand[ctx->currentCommandIndex],span,chunk);
+            ctx->currentCommandIndex += chunk;
+        }
+        else
+        {
+            ctx->currentCommandIndex = WCDLI_MAX_CHARS_PER_LINE + 1;
+        }
+
+        // The span is released only when copied: the RX interrupt writes there
+        ringSkip(&ctx->rxRing,(end != NULL) ? (chunk + 1) : chunk);
+
+        if (end != NULL)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*!
+ * Send a response of the binary mode. The result payload must be just into
+ * the response, after the ID and the status.
+ */
+static void sendBinary (WCDLI_Context_t* ctx, uint8_t* response, uint16_t id, WCDLI_BinaryStatus_t status, uint16_t length)
+{
+    uint8_t encoded[WCDLI_BINARY_MAX_RESPONSE + 5 + ((WCDLI_BINARY_MAX_RESPONSE + 5) / 254) + 2];
+    uint16_t crc = 0;
+
+    response[0] = (uint8_t)id;
+    response[1] = (uint8_t)(id >> 8);
+    response[2] = (uint8_t)status;
+    length += 3;
+    crc = crc16(response,length);
+    response[length++] = (uint8_t)crc;
+    response[length++] = (uint8_t)(crc >> 8);
+
+    writeData(ctx,encoded,cobsEncode(response,length,encoded));
+    writeFlush(ctx);
+}
+
+/*!
+ * \return The command with the ID of the binary mode, NULL when not found.
+ */
+static const WCDLI_Command_t* findCommandById (uint16_t id)
+{
+    if (id < WCDLI_COMMANDS_SIZE)
+    {
+        return &mCommands[id];
+    }
+    if ((id >= WCDLI_BINARY_ID_COMMANDS) && (id < (WCDLI_BINARY_ID_COMMANDS + mExternalCommandsIndex)))
+    {
+        return &mExternalCommands[id - WCDLI_BINARY_ID_COMMANDS];
+    }
+    if ((id >= WCDLI_BINARY_ID_APPS) && (id < (WCDLI_BINARY_ID_APPS + mExternalAppsIndex)))
+    {
+        return &mExternalApps[id - WCDLI_BINARY_ID_APPS];
+    }
+    return NULL;
+}
+
+/*!
+ * Check and dispatch the packet of the current command, and answer.
+ */
+static void processBinary (WCDLI_Context_t* ctx)
+{
+    uint8_t* packet = (uint8_t*)ctx->currentCommand;
+    uint8_t response[WCDLI_BINARY_MAX_RESPONSE + 5];
+    uint16_t responseLength = WCDLI_BINARY_MAX_RESPONSE;
+    uint16_t length = 0;
+    uint16_t id = WCDLI_BINARY_ID_ERROR;
+    WCDLI_BinaryStatus_t status = WCDLI_BINARYSTATUS_WRONG_FRAME;
+    const WCDLI_Command_t* command = NULL;
+
+    // Empty packets are only delimiters, used to sync
+    if (ctx->currentCommandIndex == 0)
+    {
+        return;
+    }
+
+    if (ctx->currentCommandIndex <= WCDLI_MAX_CHARS_PER_LINE)
+    {
+        length = cobsDecode(packet,ctx->currentCommandIndex);
+    }
+    resetBuffer(ctx);
+
+    if ((length < 4) ||
+        (crc16(packet,length - 2) != (packet[length-2] | (packet[length-1] << 8))))
+    {
+        sendBinary(ctx,response,id,status,0);
+        return;
+    }
+
+    id = packet[0] | (packet[1] << 8);
+    command = findCommandById(id);
+
+    if (id == WCDLI_BINARY_ID_EXIT)
+    {
+        sendBinary(ctx,response,id,WCDLI_BINARYSTATUS_SUCCESS,0);
+        ctx->operativeMode = WCDLI_OPERATIVEMODE_COMMAND;
+        prompt(ctx);
+        return;
+    }
+    else if (command == NULL)
+    {
+        ctx->counters.unknownCommands++;
+        status = WCDLI_BINARYSTATUS_NOT_FOUND;
+        responseLength = 0;
+    }
+    else if (command->binaryCallback == NULL)
+    {
+        status = WCDLI_BINARYSTATUS_NOT_SUPPORTED;
+        responseLength = 0;
+    }
+    else
+    {
+#if (WCDLI_PROFILING > 0)
+        uint32_t start = WCDLI_getCycles();
+        status = command->binaryCallback(command->device,&packet[2],length - 4,&response[3],&responseLength);
+        profileRecord(findStats(command),WCDLI_getCycles() - start);
+#else
+        status = command->binaryCallback(command->device,&packet[2],length - 4,&response[3],&responseLength);
+#endif
+        if (responseLength > WCDLI_BINARY_MAX_RESPONSE)
+        {
+            responseLength = WCDLI_BINARY_MAX_RESPONSE;
+        }
+    }
+    sendBinary(ctx,response,id,status,responseLength);
+}
+
+WCDLI_Error_t WCDLI_getCommandId (const char* name, uint16_t* id)
+{
+    bool isAmbiguous = FALSE;
+    const WCDLI_Command_t* command = NULL;
+
+    if ((name == NULL) || (id == NULL))
+    {
+        return WCDLI_ERROR_WRONG_PARAMS;
+    }
+
+    command = findCommand(name);
+    if (command != NULL)
+    {
+        *id = command - mCommands;
+        return WCDLI_ERROR_SUCCESS;
+    }
+
+    command = findIndex(name,&isAmbiguous);
+    if ((command >= mExternalCommands) && (command < &mExternalCommands[WCDLI_MAX_EXTERNAL_COMMAND]))
+    {
+        *id = WCDLI_BINARY_ID_COMMANDS + (command - mExternalCommands);
+        return WCDLI_ERROR_SUCCESS;
+    }
+    if ((command >= mExternalApps) && (command < &mExternalApps[WCDLI_MAX_EXTERNAL_APP]))
+    {
+        *id = WCDLI_BINARY_ID_APPS + (command - mExternalApps);
+        return WCDLI_ERROR_SUCCESS;
+    }
+    return WCDLI_ERROR_WRONG_PARAMS;
+}
+
+/*!
+ * Parse an integer without the C library: no locale, no errno.
+ *
+ * \param[in]   text: Decimal with an optional sign, or hexadecimal with an
+ *                    optional 0x when base is 16.
+ * \param[in]   base: 10 or 16.
+ * \param[out] value:
+ * \return FALSE when the text is not a number, or it needs more than 32 bits.
+ */
+static bool parseInteger (const char* text, uint8_t base, int64_t* value)
+{
+    bool isNegative = FALSE;
+    uint64_t result = 0;
+    uint8_t digit = 0;
+    char c = 0;
+
+    if ((base == 10) && ((*text == '-') || (*text == '+')))
+    {
+        isNegative = (*text++ == '-');
+    }
+    else if ((base == 16) && (text[0] == '0') && ((text[1] | 0x20) == 'x'))
+    {
+        text += 2;
+    }
+    if (*text == '\0')
+    {
+        return FALSE;
+    }
+
+    for (; *text != '\0'; ++text)
+    {
+        c = *text;
+        if ((c >= '0') && (c <= '9'))
+        {
+            digit = c - '0';
+        }
+        else if ((base == 16) && ((c | 0x20) >= 'a') && ((c | 0x20) <= 'f'))
+        {
+            digit = (c | 0x20) - 'a' + 10;
+        }
+        else
+        {
+            return FALSE;
+        }
+
+        result = (result * base) + digit;
+        if (result > 0xFFFFFFFFull)
+        {
+            return FALSE;
+        }
+    }
+    *value = (isNegative == TRUE) ? -(int64_t)result : (int64_t)result;
+    return TRUE;
+}
+
+/*!
+ * Parse a number in fixed point notation without the C library.
+ *
+ * \param[in]   text: As -12.5, +3 or .25.
+ * \param[out] value:
+ * \return FALSE when the text is not a number.
+ */
+static bool parseFloat (const char* text, float* value)
+{
+    bool isNegative = FALSE;
+    bool hasDigits = FALSE;
+    float result = 0.0f;
+    float scale = 1.0f;
+
+    if ((*text == '-') || (*text == '+'))
+    {
+        isNegative = (*text++ == '-');
+    }
+
+    for (; (*text >= '0') && (*text <= '9'); ++text)
+    {
+        result = (result * 10.0f) + (float)(*text - '0');
+        hasDigits = TRUE;
+    }
+    if (*text == '.')
+    {
+        for (++text; (*text >= '0') && (*text <= '9'); ++text)
+        {
+            scale *= 0.1f;
+            result += (float)(*text - '0') * scale;
+            hasDigits = TRUE;
+        }
+    }
+    if ((*text != '\0') || (hasDigits == FALSE))
+    {
+        return FALSE;
+    }
+
+    *value = (isNegative == TRUE) ? -result : result;
+    return TRUE;
+}
+
+/*!
+ * Parse and check an argument against its schema.
+ *
+ * \return The reason of the error, NULL when the argument is valid.
+ */
+static const char* parseArg (const WCDLI_ArgSchema_t* arg, const char* text, WCDLI_ArgValue_t* value)
+{
+    int64_t number = 0;
+
+    switch (arg->type)
+    {
+    case WCDLI_ARGTYPE_INT:
+    case WCDLI_ARGTYPE_UINT:
+    case WCDLI_ARGTYPE_HEX:
+        if (parseInteger(text,(arg->type == WCDLI_ARGTYPE_HEX) ? 16 : 10,&number) == FALSE)
+        {
+            return "is not a number";
+        }
+        if (((arg->type == WCDLI_ARGTYPE_INT) && ((number < INT32_MIN) || (number > INT32_MAX))) ||
+            ((arg->type != WCDLI_ARGTYPE_INT) && (number < 0)) ||
+            ((arg->min != arg->max) && ((number < arg->min) || (number > arg->max))))
+        {
+            return "is out of range";
+        }
+        if (arg->type == WCDLI_ARGTYPE_INT)
+        {
+            value->as.i = (int32_t)number;
+        }
+        else
+        {
+            value->as.u = (uint32_t)number;
+        }
+        break;
+
+    case WCDLI_ARGTYPE_FLOAT:
+        if (parseFloat(text,&value->as.f) == FALSE)
+        {
+            return "is not a number";
+        }
+        if ((arg->min != arg->max) && ((value->as.f < arg->min) || (value->as.f > arg->max)))
+        {
+            return "is out of range";
+        }
+        break;
+
+    case WCDLI_ARGTYPE_ENUM:
+        for (value->as.u = 0; arg->values[value->as.u] != NULL; ++value->as.u)
+        {
+            if (strcmp(arg->values[value->as.u],text) == 0)
+            {
+                break;
+            }
+        }
+        if (arg->values[value->as.u] == NULL)
+        {
+            return "is not a valid value";
+        }
+        break;
+
+    case WCDLI_ARGTYPE_STRING:
+    default:
+        value->as.s = text;
+        break;
+    }
+
+    value->isSet = TRUE;
+    return NULL;
+}
+
+/*!
+ * Print the usage of a command from its schema, as
+ * "Usage: name <a> [<b>] [--c=<c>]", the values of an enum in place of the
+ * name.
+ */
+static void printUsage (WCDLI_Context_t* ctx, const char* name, const WCDLI_CommandSchema_t* schema)
+{
+    const WCDLI_ArgSchema_t* arg = NULL;
+
+    writeString(ctx,"Usage: ");
+    writeString(ctx,name);
+    for (uint8_t i = 0; i < schema->count; ++i)
+    {
+        arg = &schema->args[i];
+
+        writeString(ctx,((arg->flags & (WCDLI_ARGFLAG_OPTIONAL | WCDLI_ARGFLAG_OPTION)) != 0) ? " [" : " ");
+        if ((arg->flags & WCDLI_ARGFLAG_OPTION) != 0)
+        {
+            writeString(ctx,"--");
+            writeString(ctx,arg->name);
+            writeString(ctx,"=");
+        }
+        writeString(ctx,"<");
+        if (arg->type == WCDLI_ARGTYPE_ENUM)
+        {
+            for (uint8_t j = 0; arg->values[j] != NULL; ++j)
+            {
+                writeString(ctx,(j > 0) ? "|" : "");
+                writeString(ctx,arg->values[j]);
+            }
+        }
+        else
+        {
+            writeString(ctx,arg->name);
+        }
+        writeString(ctx,((arg->flags & (WCDLI_ARGFLAG_OPTIONAL | WCDLI_ARGFLAG_OPTION)) != 0) ? ">]" : ">");
+    }
+    WCDLI_PRINT_NEW_LINE(ctx);
+}
+
+/*!
+ * Parse the arguments of the current command against its schema, in one
+ * pass: the positional arguments in the order of the schema, the options
+ * as --name=value anywhere.
+ *
+ * \param[out] values: The values in the order of the schema.
+ * \return FALSE, with the error and the usage printed, when an argument is
+ *         wrong, missing or unknown.
+ */
+static bool parseSchema (WCDLI_Context_t* ctx, const WCDLI_Command_t* command, WCDLI_ArgValue_t* values)
+{
+    const WCDLI_CommandSchema_t* schema = command->schema;
+    const WCDLI_ArgSchema_t* arg = NULL;
+    const char* text = NULL;
+    const char* error = NULL;
+    const char* name = NULL;
+    uint8_t positional = 0;
+    uint8_t i = 0;
+
+    memset(values,0,schema->count * sizeof(WCDLI_ArgValue_t));
+
+    for (uint8_t p = 1; (p < ctx->numberOfParams) && (error == NULL); ++p)
+    {
+        text = ctx->params[p];
+        name = text;
+
+        if ((text[0] == '-') && (text[1] == '-'))
+        {
+            // --name=value
+            const char* key = &text[2];
+            text = strchr(key,'=');
+            for (i = 0; (text != NULL) && (i < schema->count); ++i)
+            {
+                arg = &schema->args[i];
+                if (((arg->flags & WCDLI_ARGFLAG_OPTION) != 0) &&
+                    (strncmp(arg->name,key,text - key) == 0) && (arg->name[text - key] == '\0'))
+                {
+                    break;
+                }
+            }
+            if ((text == NULL) || (i == schema->count))
+            {
+                error = "is not an option";
+            }
+            else
+            {
+                name = arg->name;
+                error = parseArg(arg,text + 1,&values[i]);
+            }
+        }
+        else
+        {
+            while ((positional < schema->count) && ((schema->args[positional].flags & WCDLI_ARGFLAG_OPTION) != 0))
+            {
+                positional++;
+            }
+            if (positional == schema->count)
+            {
+                error = "is one argument too many";
+                break;
+            }
+            arg = &schema->args[positional];
+            name = arg->name;
+            error = parseArg(arg,text,&values[positional++]);
+        }
+    }
+
+    for (i = 0; (i < schema->count) && (error == NULL); ++i)
+    {
+        if ((values[i].isSet == FALSE) && ((schema->args[i].flags & (WCDLI_ARGFLAG_OPTIONAL | WCDLI_ARGFLAG_OPTION)) == 0))
+        {
+            name = schema->args[i].name;
+            error = "is missing";
+        }
+    }
+
+    if (error != NULL)
+    {
+        WCDLI_debugByFormat_ex(ctx,WCDLI_MESSAGELEVEL_NONE,"Error: %s %s!" WCDLI_NEW_LINE,name,error);
+        printUsage(ctx,command->name,schema);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*!
+ * Call the command, copying the arguments into the layout of
+ * WCDLI_CommandCallback_t when it has no pointer-based callback.
+ */
+static void callCommand (WCDLI_Context_t* ctx, const WCDLI_Command_t* command)
+{
+    if (command->resumableCallback != NULL)
+    {
+        ctx->run.step        = 0;
+        ctx->run.isCancelled = FALSE;
+        if (command->resumableCallback(command->device,ctx->numberOfParams,ctx->params,&ctx->run) ==
+            WCDLI_COMMANDSTATE_RUNNING)
+        {
+            // Continued by the next WCDLI_ckeck() calls
+            ctx->runningCommand = *command;
+            ctx->isRunning      = TRUE;
+            ctx->busyEvents     = ctx->rxEvents;
+        }
+    }
+    else if (command->schema != NULL)
+    {
+        WCDLI_ArgValue_t values[WCDLI_MAX_PARAMS];
+
+        // The static commands are checked by buildCommandsHash() too
+        if (command->schema->count > WCDLI_MAX_PARAMS)
+        {
+            WCDLI_PRINT_WRONG_PARAM();
+        }
+        else if (parseSchema(ctx,command,values) == TRUE)
+        {
+            command->schema->callback(command->device,command->schema->count,values);
+        }
+    }
+    else if (command->argvCallback != NULL)
+    {
+        command->argvCallback(command->device,ctx->numberOfParams,ctx->params);
+    }
+    else if (command->callback == NULL)
+    {
+        // Binary mode only
+        WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+    }
+    else
+    {
+        char params[WCDLI_MAX_PARAMS][WCDLI_BUFFER_SIZE];
+
+        for (uint8_t i = 0; i < ctx->numberOfParams; ++i)
+        {
+            strncpy(params[i],ctx->params[i],WCDLI_BUFFER_SIZE-1);
+            params[i][WCDLI_BUFFER_SIZE-1] = '\0';
+        }
+        command->callback(command->device,ctx->numberOfParams,params);
+    }
+}
+
+/*!
+ * \return The first separator of the commands out of the double quotes, or
+ *         end when there is none.
+ */
+static char* findSeparator (char* c, char* const end)
+{
+    bool isQuoted = FALSE;
+
+    for (; c < end; ++c)
+    {
+        if (*c == '\"')
+        {
+            isQuoted = !isQuoted;
+        }
+        else if ((*c == WCDLI_COMMAND_SEPARATOR) && (isQuoted == FALSE))
+        {
+            break;
+        }
+    }
+    return c;
+}
+
+static void startBatch (void* app, int argc, const char* argv[])
+{
+    WCDLI_Context_t* ctx = commandContext();
+
+    ctx->isBatch       = TRUE;
+    ctx->batchCommands = 0;
+    ctx->batchErrors   = 0;
+}
+
+static void endBatch (WCDLI_Context_t* ctx)
+{
+    ctx->isBatch = FALSE;
+    WCDLI_debugByFormat_ex(ctx,WCDLI_MESSAGELEVEL_NONE,"Batch: %u commands, %u errors" WCDLI_NEW_LINE,
+                           ctx->batchCommands,ctx->batchErrors);
+}
+
+/*!
+ * Run a command of the current line.
+ *
+ * \param[in] line: The command.
+ * \param[in]  end: The terminator of the command.
+ */
+static void executeCommand (WCDLI_Context_t* ctx, char* line, char* const end)
+{
+    WCDLI_Command_t command = {0};
+    const WCDLI_Command_t* found = NULL;
+    bool changeMode = FALSE;
+    bool isAmbiguous = FALSE;
+    // The command that starts the batch is not counted
+    bool isBatch = ctx->isBatch;
+
+    while ((line < end) && (*line == ' '))
+    {
+        line++;
+    }
+    if (line == end)
+    {
+        return;
+    }
+
+    if ((isBatch == TRUE) && (strncmp(line,WCDLI_END_BATCH,strlen(WCDLI_END_BATCH)) == 0) &&
+        isCommandNameEnd(line[strlen(WCDLI_END_BATCH)]))
+    {
+        endBatch(ctx);
+        return;
+    }
+
+    //WCDLI_PRINT_NEW_LINE();
+    found = parseCommand(ctx,line,&command,&changeMode,&isAmbiguous);
+
+    if (command.name != NULL)
+    {
+        if (changeMode == FALSE)
+        {
+            // Parse params
+            parseParams(ctx,line,end);
+#if (WCDLI_PROFILING > 0)
+            uint32_t start = WCDLI_getCycles();
+            callCommand(ctx,&command);
+            uint32_t cycles = WCDLI_getCycles() - start;
+
+            // A running command is recorded at the end of its run
+            if (ctx->isRunning == TRUE)
+            {
+                ctx->runStats  = findStats(found);
+                ctx->runCycles = cycles;
+            }
+            else
+            {
+                profileRecord(findStats(found),cycles);
+            }
+#else
+            (void)found;
+            callCommand(ctx,&command);
+#endif
+        }
+        else
+        {
+            changeOperativeMode(ctx,command.name);
+        }
+    }
+    else
+    {
+        if ((ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND) && (isAmbiguous == TRUE))
+        {
+            ctx->counters.unknownCommands++;
+            WCDLI_PRINT_AMBIGUOUS_COMMAND();
+        }
+        else if (ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND)
+        {
+            // Command not found!
+            ctx->counters.unknownCommands++;
+            WCDLI_PRINT_NO_COMMAND();
+        }
+    }
+
+    if (isBatch == TRUE)
+    {
+        ctx->batchCommands++;
+        if (command.name == NULL)
+        {
+            ctx->batchErrors++;
+        }
+    }
+}
+
+/*!
+ * Run the commands of the current line, separated by
+ * WCDLI_COMMAND_SEPARATOR. The commands after a resumable command wait the
+ * end of its run.
+ *
+ * \param[in] line: The first command to run.
+ * \param[in]  end: The terminator of the line.
+ */
+static void executeLine (WCDLI_Context_t* ctx, char* line, char* const end)
+{
+    char* next = NULL;
+
+    ctx->nextCommand = NULL;
+    ctx->lineEnd     = end;
+    for (;;)
+    {
+        next = findSeparator(line,end);
+        *next = '\0';
+        executeCommand(ctx,line,next);
+
+        if (next == end)
+        {
+            break;
+        }
+        line = next + 1;
+
+        if (ctx->isRunning == TRUE)
+        {
+            ctx->nextCommand = line;
+            break;
+        }
+    }
+}
+
+/*!
+ * Print the prompt at the end of a line, unless the line is still running.
+ */
+static void endLine (WCDLI_Context_t* ctx)
+{
+    // An open response prints the prompt when it is closed
+    if ((ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND) && (ctx->isBatch == FALSE) &&
+        (ctx->isResponseOpen == FALSE) && (ctx->isRunning == FALSE))
+    {
+        prompt(ctx);
+    }
+    else
+    {
+        resetBuffer(ctx);
+    }
+}
+
+/*!
+ * Continue the running command, or cancel it when Ctrl-C was received; then
+ * run the rest of its line.
+ */
+static void resumeCommand (WCDLI_Context_t* ctx)
+{
+    WCDLI_CommandResumableCallback_t callback = ctx->runningCommand.resumableCallback;
+    WCDLI_CommandState_t state = WCDLI_COMMANDSTATE_DONE;
+#if (WCDLI_PROFILING > 0)
+    uint32_t start = WCDLI_getCycles();
+#endif
+
+    if (ctx->isCancelRequested == TRUE)
+    {
+        // The last call lets the command clean up
+        ctx->isCancelRequested = FALSE;
+        ctx->run.isCancelled = TRUE;
+        callback(ctx->runningCommand.device,ctx->numberOfParams,ctx->params,&ctx->run);
+        ctx->nextCommand = NULL;
+        WCDLI_PRINT_CANCELLED();
+    }
+    else
+    {
+        state = callback(ctx->runningCommand.device,ctx->numberOfParams,ctx->params,&ctx->run);
+    }
+#if (WCDLI_PROFILING > 0)
+    ctx->runCycles += WCDLI_getCycles() - start;
+#endif
+
+    if (state == WCDLI_COMMANDSTATE_RUNNING)
+    {
+        // The new lines wait: tell it once for every new line
+        if ((ctx->isBatch == FALSE) && (ctx->busyEvents != ctx->rxEvents))
+        {
+            ctx->busyEvents = ctx->rxEvents;
+            WCDLI_PRINT_BUSY();
+        }
+        return;
+    }
+
+    ctx->isRunning = FALSE;
+#if (WCDLI_PROFILING > 0)
+    profileRecord(ctx->runStats,ctx->runCycles);
+#endif
+    if (ctx->nextCommand != NULL)
+    {
+        executeLine(ctx,ctx->nextCommand,ctx->lineEnd);
+    }
+    endLine(ctx);
+}
+
+_weak void WCDLI_printProjectVersion (void* app, int argc, const char* argv[])
+{
+    char message[WCDLI_MAX_CHARS_PER_LINE] = {0};
+    bool isHello = false;
+
+    if ((app == 0) && (argc == 0) && (argv == 0))
+    {
+        isHello = true;
+    }
+
+    /* Board version */
+#if defined (BOARD_VERSION_STRING)
+    formatString(message,sizeof(message),"%s : %s",WCDLI_BOARD_STRING,BOARD_VERSION_STRING);
+    if (isHello)
+    {
+        writeStringln(commandContext(),message);
+    }
+    else
+    {
+        WCDLI_debug(WCDLI_MESSAGELEVEL_NONE, message);
+    }
+#endif
+
+#if defined (FIRMWARE_VERSION_STRING) || (defined (FIRMWARE_VERSION_MAJOR) && defined (FIRMWARE_VERSION_TIME))
+#if defined (FIRMWARE_VERSION_STRING)
+    formatString(message,sizeof(message),"%s : %s",WCDLI_FIRMWARE_STRING,FIRMWARE_VERSION_STRING);
+    if (isHello)
+    {
+        writeStringln(commandContext(),message);
+    }
+    else
+    {
+        WCDLI_debug(WCDLI_MESSAGELEVEL_NONE, message);
+    }
+#else
+    char versionString[64] = {0};
+    Utility_Version_t v =
+    {
+        .f.major    = FIRMWARE_VERSION_MAJOR,
+        .f.minor    = FIRMWARE_VERSION_MINOR,
+        .f.subminor = FIRMWARE_VERSION_SUBMINOR,
+        .f.time     = FIRMWARE_VERSION_TIME,
+    };
+    Utility_getVersionString(&v,versionString);
+    formatString(message,sizeof(message),"%s : %s",WCDLI_FIRMWARE_STRING,versionString);
+    if (isHello)
+    {
+        writeStringln(commandContext(),message);
+    }
+    else
+    {
+        WCDLI_debug(WCDLI_MESSAGELEVEL_NONE, message);
+    }
+#endif
+#else
+    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+#endif
+}
+
+/*!
+ * Print a counter of the status.
+ */
+static void printCounter (WCDLI_Context_t* ctx, const char* name, uint32_t value, const char* unit)
+{
+    writeFormat(ctx,"%-24s %10lu %s" WCDLI_NEW_LINE,name,(unsigned long)value,unit);
+}
+
+_weak void WCDLI_printStatus (void* app, int argc, const char* argv[])
+{
+    WCDLI_Context_t* ctx = commandContext();
+    const WCDLI_Counters_t* counters = &ctx->counters;
+
+    if ((argc == 2) && (strcmp(argv[1],"reset") == 0))
+    {
+        WCDLI_resetCounters_ex(ctx);
+        WCDLI_PRINT_SUCCESS();
+        return;
+    }
+    else if (argc != 1)
+    {
+        WCDLI_PRINT_WRONG_PARAM();
+        return;
+    }
+
+    printCounter(ctx,"RX bytes",counters->rxBytes,"bytes");
+    printCounter(ctx,"RX overruns",counters->rxOverruns,"bytes");
+    printCounter(ctx,"RX high water",counters->rxHighWater,"bytes");
+    printCounter(ctx,"RX pauses",counters->rxPauses,"times");
+    printCounter(ctx,"TX bytes",counters->txBytes,"bytes");
+    printCounter(ctx,"TX blocked",(uint32_t)(counters->txBlockedCycles / 1000u),"k" WCDLI_CYCLES_UNIT);
+    printCounter(ctx,"Lines parsed",counters->lines,"lines");
+    printCounter(ctx,"Unknown commands",counters->unknownCommands,"commands");
+    printCounter(ctx,"Truncated log lines",counters->truncatedLogs,"lines");
+    WCDLI_PRINT_NEW_LINE(ctx);
+}
+
+const WCDLI_Counters_t* WCDLI_getCounters_ex (WCDLI_Context_t* ctx)
+{
+    return &ctx->counters;
+}
+
+const WCDLI_Counters_t* WCDLI_getCounters (void)
+{
+    return WCDLI_getCounters_ex(WCDLI_mainContext);
+}
+
+void WCDLI_resetCounters_ex (WCDLI_Context_t* ctx)
+{
+    // A byte received meanwhile can be counted before the clear
+    memset(&ctx->counters,0,sizeof(ctx->counters));
+}
+
+void WCDLI_resetCounters (void)
+{
+    WCDLI_resetCounters_ex(WCDLI_mainContext);
+}
+
+WCDLI_Context_t* WCDLI_currentContext (void)
+{
+    return mCurrentContext;
+}
+
+void WCDLI_ckeck_ex (WCDLI_Context_t* ctx)
+{
+    // Send what was staged since the last call
+    writeFlush(ctx);
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    // Idle time: print the queued messages
+    WCDLI_processLog_ex(ctx,WCDLI_LOG_RECORDS_PER_CHECK);
+#endif
+#if (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
+    // Idle time: print the deferred messages, they would break the packets
+    // of the binary mode
+    if ((ctx == WCDLI_mainContext) && (ctx->operativeMode != WCDLI_OPERATIVEMODE_BINARY))
+    {
+        WCDLI_processDeferred(WCDLI_DEFERRED_RECORDS_PER_CHECK);
+    }
+#endif
+#if (WCDLI_TX_BUFFER_DIMENSION > 0) && defined (LIBOHIBOARD_VERSION)
+    drainTx(ctx);
+#endif
+
+#if defined (__POSIX_HOST)
+    // Empty the pipe before the work is looked for: a later signal is kept
+    hostDrainSignal(ctx);
+#endif
+
+    // The commands print on this console
+    mCurrentContext = ctx;
+
+    if (ctx->isRunning == TRUE)
+    {
+        resumeCommand(ctx);
+    }
+    else
+    {
+        // Nothing to cancel
+        ctx->isCancelRequested = FALSE;
+    }
+
+    // A batch runs many lines at every call, otherwise one line only
+    for (uint8_t lines = 0;
+         (WCDLI_isLineReady_ex(ctx) == TRUE) &&
+         (lines < ((ctx->isBatch == TRUE) ? WCDLI_BATCH_LINES_PER_CHECK : 1));
+         ++lines)
+    {
+        ctx->rxHandled++;
+
+        if (ctx->operativeMode == WCDLI_OPERATIVEMODE_BINARY)
+        {
+            if (frameBinary(ctx) == TRUE)
+            {
+                ctx->counters.lines++;
+                processBinary(ctx);
+            }
+        }
+        else if (frameLine(ctx) == TRUE)
+        {
+            ctx->counters.lines++;
+
+            // No message, only enter command!
+            if ((ctx->currentCommandIndex == 2) && (ctx->isBatch == FALSE))
+            {
+                prompt(ctx);
+                continue;
+            }
+
+            // The line ends with "\r\n": the terminator replaces '\r'
+            char* const end = &ctx->currentCommand[ctx->currentCommandIndex-2];
+            *end = '\0';
+            executeLine(ctx,ctx->currentCommand,end);
+            endLine(ctx);
+        }
+    }
+
+    mCurrentContext = NULL;
+    rxResume(ctx);
+}
+
+void WCDLI_ckeck (void)
+{
+    WCDLI_ckeck_ex(WCDLI_mainContext);
+}
+
+/*!
+ * \return TRUE when WCDLI_ckeck() of the console has something to do.
+ */
+static bool hasWork (WCDLI_Context_t* ctx)
+{
+    if ((WCDLI_isLineReady_ex(ctx) == TRUE) || (ctx->isRunning == TRUE))
+    {
+        return TRUE;
+    }
+    // The remote waits the restart
+    if ((ctx->isRxPaused == TRUE) && (ctx->rxHandled == ctx->rxEvents))
+    {
+        return TRUE;
+    }
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    if (logPeek(&ctx->logQueue) != NULL)
+    {
+        return TRUE;
+    }
+#endif
+#if (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
+    if ((ctx == WCDLI_mainContext) && (ringCount(&mDeferredRing) > 0))
+    {
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
+bool WCDLI_isLineReady_ex (WCDLI_Context_t* ctx)
+{
+    // The lines wait the end of the open response and of the running command
+    return ((ctx->rxHandled != ctx->rxEvents) &&
+            (ctx->isResponseOpen == FALSE) && (ctx->isRunning == FALSE));
+}
+
+bool WCDLI_isLineReady (void)
+{
+    return WCDLI_isLineReady_ex(WCDLI_mainContext);
+}
+
+_weak void WCDLI_signal (WCDLI_Context_t* ctx)
+{
+#if defined (__POSIX_HOST)
+    uint8_t c = 0;
+
+    if ((ctx->signal[1] >= 0) && (write(ctx->signal[1],&c,1) < 0))
+    {
+        // The pipe is full: the console is just awake
+    }
+#else
+    // The interrupt that calls it ends the sleep
+    (void)ctx;
+#endif
+}
+
+#if !defined (__POSIX_HOST) && !defined (LIBOHIBOARD_VERSION)
+/*!
+ * The core cycles passed since the previous call, for the timeout of
+ * WCDLI_waitSignal() without the system tick of libohiboard: they are read
+ * from the cycle counter where the core has it, otherwise from the SysTick
+ * counter, whose interrupt ends the sleep before it wraps twice.
+ */
+static uint32_t waitCycles (uint32_t* last)
+{
+#if defined (DWT_CTRL_CYCCNTENA_Msk)
+    uint32_t now = DWT->CYCCNT;
+    uint32_t delta = now - *last;
+#else
+    // The SysTick counts down, from LOAD to zero
+    uint32_t now = SysTick->VAL;
+    uint32_t period = (SysTick->LOAD & SysTick_LOAD_RELOAD_Msk) + 1u;
+    uint32_t delta = (*last >= now) ? (*last - now) : (*last + period - now);
+#endif
+
+    *last = now;
+    return delta;
+}
+#endif
+
+_weak void WCDLI_waitSignal (WCDLI_Context_t* ctx, uint32_t timeout)
+{
+#if defined (__POSIX_HOST)
+    struct pollfd events[2] =
+    {
+        {.fd = ctx->signal[0],  .events = POLLIN},
+        {.fd = ctx->device->rx, .events = POLLIN},
+    };
+    struct timespec start, current;
+    uint64_t elapsed = 0;
+    int wait = -1;
+    bool isOpen = TRUE;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    while (hasWork(ctx) == FALSE)
+    {
+        if (timeout != WCDLI_WAIT_FOREVER)
+        {
+            clock_gettime(CLOCK_MONOTONIC,&current);
+            elapsed = ((uint64_t)(current.tv_sec - start.tv_sec) * 1000u) +
+                      ((current.tv_nsec / 1000000) - (start.tv_nsec / 1000000));
+            if (elapsed >= timeout)
+            {
+                return;
+            }
+            wait = ((timeout - elapsed) > INT32_MAX) ? INT32_MAX : (int)(timeout - elapsed);
+        }
+
+        // The device is not read while the remote is paused
+        events[1].fd = ((isOpen == TRUE) && (ctx->device->isRxReady == TRUE)) ? ctx->device->rx : -1;
+        if ((poll(events,2,wait) < 0) && (errno != EINTR))
+        {
+            return;
+        }
+        // The device is read here, as by its interrupt
+        if ((events[1].revents & POLLIN) != 0)
+        {
+            WCDLI_callbackRx(ctx->device,ctx);
+        }
+        else if ((events[1].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0)
+        {
+            isOpen = FALSE;
+        }
+    }
+#elif defined (LIBOHIBOARD_VERSION)
+    uint32_t start = System_currentTick();
+
+    // The system tick ends every sleep
+    while ((timeout == WCDLI_WAIT_FOREVER) || ((System_currentTick() - start) < timeout))
+    {
+        // With the interrupts masked, a pending interrupt still ends the
+        // sleep, and runs when they are unmasked
+        WCDLI_ENTER_CRITICAL();
+        bool isIdle = (hasWork(ctx) == FALSE);
+        if (isIdle)
+        {
+            __WFI();
+        }
+        WCDLI_EXIT_CRITICAL();
+        if (!isIdle)
+        {
+            break;
+        }
+    }
+#else
+    const uint64_t limit = (uint64_t)timeout * (SystemCoreClock / 1000u);
+    uint64_t cycles = 0;
+    uint32_t last = 0;
+
+    waitCycles(&last);
+    while ((timeout == WCDLI_WAIT_FOREVER) || (cycles < limit))
+    {
+        WCDLI_ENTER_CRITICAL();
+        bool isIdle = (hasWork(ctx) == FALSE);
+        if (isIdle)
+        {
+            __WFI();
+        }
+        WCDLI_EXIT_CRITICAL();
+        if (!isIdle)
+        {
+            break;
+        }
+#if !defined (DWT_CTRL_CYCCNTENA_Msk)
+        // No running SysTick: the time can not be measured
+        if ((SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) == 0)
+        {
+            break;
+        }
+#endif
+        cycles += waitCycles(&last);
+    }
+#endif
+}
+
+bool WCDLI_wait_ex (WCDLI_Context_t* ctx, uint32_t timeout)
+{
+    if (hasWork(ctx) == FALSE)
+    {
+        WCDLI_waitSignal(ctx,timeout);
+    }
+#if defined (__POSIX_HOST)
+    else if (ctx->isRunning == TRUE)
+    {
+        // Ctrl-C and the new lines are read while the command runs
+        WCDLI_callbackRx(ctx->device,ctx);
+    }
+#endif
+    return hasWork(ctx);
+}
+
+bool WCDLI_wait (uint32_t timeout)
+{
+    return WCDLI_wait_ex(WCDLI_mainContext,timeout);
+}
+
+void WCDLI_init_ex (WCDLI_Context_t* ctx, WCDLI_Device_t dev)
+{
+    if ((ctx == NULL) || (dev == NULL))
+    {
+#if defined (LIBOHIBOARD_VERSION)
+        ohiassert(0);
+#else
+        assert(0);
+#endif
+        return;
+    }
+    // Save device handle
+    ctx->device = dev;
+
+    // Initialize buffer descriptor
+    ringInit(&ctx->rxRing,ctx->rxBuffer,WCDLI_BUFFER_DIMENSION+1);
+    ctx->currentCommandIndex = 0;
+    ctx->numberOfParams      = 0;
+    ctx->operativeMode       = WCDLI_DEFAULT_OPERATIVE_MODE;
+    ctx->debugLevel          = WCDLI_DEBUG_MESSAGE_LEVEL;
+    ctx->outputIndex         = 0;
+    ctx->outputFlushPolicy   = WCDLI_OUTPUT_FLUSH_POLICY;
+    ctx->rxEvents            = 0;
+    ctx->rxHandled           = 0;
+    ctx->rxLength            = 0;
+    ctx->rxCircularPosition  = 0;
+    ctx->isBatch             = FALSE;
+    ctx->batchCommands       = 0;
+    ctx->batchErrors         = 0;
+    ctx->isResponseOpen      = FALSE;
+    ctx->isRunning           = FALSE;
+    ctx->isCancelRequested   = FALSE;
+    ctx->busyEvents          = 0;
+    ctx->nextCommand         = NULL;
+    ctx->lineEnd             = NULL;
+    ctx->flowControl         = WCDLI_FLOW_CONTROL;
+    ctx->isRxPaused          = FALSE;
+    memset(&ctx->run,0,sizeof(ctx->run));
+    memset(&ctx->counters,0,sizeof(ctx->counters));
+#if (WCDLI_PROFILING > 0)
+    ctx->runStats            = NULL;
+    ctx->runCycles           = 0;
+#endif
+#if (WCDLI_LOG_TIMESTAMP > 0)
+    // The first message has the absolute time
+    ctx->logTimestamp        = 0;
+    ctx->logTimestampSync    = 0;
+#endif
+    initCycles();
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    logInit(&ctx->logQueue);
+#endif
+#if defined (__POSIX_HOST)
+    hostOpenSignal(ctx);
+    ctx->device->isRxReady = TRUE;
+    ctx->lastRx = 0;
+#endif
+
+#if (WCDLI_TX_BUFFER_DIMENSION > 0)
+    ringInit(&ctx->txRing,ctx->txBuffer,WCDLI_TX_BUFFER_DIMENSION+1);
+    ctx->txOverflowPolicy = WCDLI_TX_OVERFLOW_POLICY;
+#if defined (__POSIX_HOST)
+    // The thread plays the role of the TX interrupt
+    pthread_mutex_init(&ctx->txMutex,NULL);
+    pthread_cond_init(&ctx->txEvent,NULL);
+    ctx->txPending = FALSE;
+    pthread_create(&ctx->txThread,NULL,hostTxThread,ctx);
+#endif
+#endif
+
+    // The shared state is initialized with the first console
+    if (mPromptString[0] == '\0')
+    {
+        WCDLI_mainContext = ctx;
+
+#if (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
+        ringInit(&mDeferredRing,mDeferredBuffer,WCDLI_DEFERRED_BUFFER_DIMENSION+1);
+#endif
+
+        // Build the static commands index
+        buildCommandsHash();
+
+//        strcat(mPromptString,WCDLI_NEW_LINE);
+        formatString(mPromptString,sizeof(mPromptString),"%c> ",WCDLI_PROMPT_CHAR);
+    }
+
+#if defined (LIBOHIBOARD_VERSION)
+    // Last step: the RX interrupt finds the context ready
+    ctx->next = mContexts;
+    mContexts = ctx;
+    Uart_addRxCallback(ctx->device,callbackRx);
+#else
+    // This association is external...
+#endif
+
+    // Send Hello World!
+    sayHello(ctx);
+    prompt(ctx);
+}
+
+#if defined (LIBOHIBOARD_VERSION)
+void WCDLI_init (Uart_DeviceHandle dev)
+#else
+#if defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+void WCDLI_init (UART_Type* dev)
+#elif defined (__MCUXPRESSO_USART)
+void WCDLI_init (USART_Type* dev)
+#endif
+#elif defined (__NUECLIPSE)
+void WCDLI_init (UART_T* dev)
+#elif defined (__POSIX_HOST)
+void WCDLI_init (WCDLI_HostDevice_t* dev)
+#endif
+#endif
+{
+    WCDLI_init_ex(&mDefaultContext,dev);
+}
+
+/*!
+ * Check the name of a new command or app: it must be a single token and it
+ * must not be used by another command.
+ */
+static WCDLI_Error_t checkName (const char* name)
+{
+    bool isAmbiguous = FALSE;
+
+    if ((name == NULL) || isCommandNameEnd(name[0]))
+    {
+        return WCDLI_ERROR_WRONG_PARAMS;
+    }
+
+    if ((findCommand(name) != NULL) || (findIndex(name,&isAmbiguous) != NULL))
+    {
+        return WCDLI_ERROR_DUPLICATED_NAME;
+    }
+    return WCDLI_ERROR_SUCCESS;
+}
+
+/*!
+ * Add a command or an app to the runtime table.
+ */
+static WCDLI_Error_t addExternal (WCDLI_Command_t* table,
+                                  uint8_t* size,
+                                  uint8_t maxSize,
+                                  const WCDLI_Command_t* command,
+                                  WCDLI_Error_t fullError)
+{
+    bool hasSchema = ((command->schema != NULL) && (command->schema->callback != NULL));
+
+#if defined (LIBOHIBOARD_VERSION)
+    ohiassert((command->callback != NULL) || (command->argvCallback != NULL) ||
+              (command->binaryCallback != NULL) || (command->resumableCallback != NULL) || hasSchema);
+#endif
+
+    if ((command->callback == NULL) && (command->argvCallback == NULL) &&
+        (command->binaryCallback == NULL) && (command->resumableCallback == NULL) && !hasSchema)
+    {
+        return WCDLI_ERROR_EMPTY_CALLBACK;
+    }
+
+    if ((command->schema != NULL) && (command->schema->count > WCDLI_MAX_PARAMS))
+    {
+        return WCDLI_ERROR_WRONG_PARAMS;
+    }
+
+    WCDLI_Error_t err = checkName(command->name);
+    if (err != WCDLI_ERROR_SUCCESS)
+    {
+        return err;
+    }
+
+    if (*size < maxSize)
+    {
+        table[*size] = *command;
+
+        err = insertIndex(&table[*size]);
+        if (err == WCDLI_ERROR_SUCCESS)
+        {
+            (*size)++;
+        }
+        return err;
+    }
+    else
+    {
+        return fullError;
+    }
+}
+
+WCDLI_Error_t WCDLI_addCommandByParam (const char* name,
+                                       const char* description,
+                                       WCDLI_CommandCallback_t callback)
+{
+    WCDLI_Command_t command = {name, description, 0, callback, NULL, NULL, NULL, NULL};
+
+    return addExternal(mExternalCommands,&mExternalCommandsIndex,WCDLI_MAX_EXTERNAL_COMMAND,
+                       &command,WCDLI_ERROR_ADD_COMMAND_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addCommandByArgv (const char* name,
+                                      const char* description,
+                                      WCDLI_CommandArgvCallback_t callback)
+{
+    WCDLI_Command_t command = {name, description, 0, NULL, callback, NULL, NULL, NULL};
+
+    return addExternal(mExternalCommands,&mExternalCommandsIndex,WCDLI_MAX_EXTERNAL_COMMAND,
+                       &command,WCDLI_ERROR_ADD_COMMAND_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addCommandBySchema (const char* name,
+                                        const char* description,
+                                        const WCDLI_CommandSchema_t* schema)
+{
+    WCDLI_Command_t command = {name, description, 0, NULL, NULL, NULL, NULL, schema};
+
+    return addExternal(mExternalCommands,&mExternalCommandsIndex,WCDLI_MAX_EXTERNAL_COMMAND,
+                       &command,WCDLI_ERROR_ADD_COMMAND_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addAppBySchema (const char* name,
+                                    const char* description,
+                                    void* app,
+                                    const WCDLI_CommandSchema_t* schema)
+{
+    WCDLI_Command_t command = {name, description, app, NULL, NULL, NULL, NULL, schema};
+
+    return addExternal(mExternalApps,&mExternalAppsIndex,WCDLI_MAX_EXTERNAL_APP,
+                       &command,WCDLI_ERROR_ADD_APP_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addResumableCommand (const char* name,
+                                         const char* description,
+                                         WCDLI_CommandResumableCallback_t callback)
+{
+    WCDLI_Command_t command = {name, description, 0, NULL, NULL, NULL, callback, NULL};
+
+    return addExternal(mExternalCommands,&mExternalCommandsIndex,WCDLI_MAX_EXTERNAL_COMMAND,
+                       &command,WCDLI_ERROR_ADD_COMMAND_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addCommand (WCDLI_Command_t* command)
+{
+#if defined (LIBOHIBOARD_VERSION)
+    ohiassert(command != NULL);
+#endif
+
+    if (command != NULL)
+    {
+        WCDLI_Command_t external = *command;
+        external.device = 0;
+
+        return addExternal(mExternalCommands,&mExternalCommandsIndex,WCDLI_MAX_EXTERNAL_COMMAND,
+                           &external,WCDLI_ERROR_ADD_COMMAND_FAIL);
+    }
+
+    return WCDLI_ERROR_ADD_COMMAND_FAIL;
+}
+
+WCDLI_Error_t WCDLI_addAppByParam (const char* name,
+                                   const char* description,
+                                   void* app,
+                                   WCDLI_CommandCallback_t callback)
+{
+    WCDLI_Command_t command = {name, description, app, callback, NULL, NULL, NULL, NULL};
+
+    return addExternal(mExternalApps,&mExternalAppsIndex,WCDLI_MAX_EXTERNAL_APP,
+                       &command,WCDLI_ERROR_ADD_APP_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addAppByArgv (const char* name,
+                                  const char* description,
+                                  void* app,
+                                  WCDLI_CommandArgvCallback_t callback)
+{
+    WCDLI_Command_t command = {name, description, app, NULL, callback, NULL, NULL, NULL};
+
+    return addExternal(mExternalApps,&mExternalAppsIndex,WCDLI_MAX_EXTERNAL_APP,
+                       &command,WCDLI_ERROR_ADD_APP_FAIL);
+}
+
+WCDLI_Error_t WCDLI_addApp (WCDLI_Command_t* app)
+{
+#if defined (LIBOHIBOARD_VERSION)
+    ohiassert(app != NULL);
+#endif
+
+    if (app != NULL)
+    {
+        return addExternal(mExternalApps,&mExternalAppsIndex,WCDLI_MAX_EXTERNAL_APP,
+                           app,WCDLI_ERROR_ADD_APP_FAIL);
+    }
+
+    return WCDLI_ERROR_ADD_APP_FAIL;
+}
+
+void WCDLI_helpLine (const char* name, const char* description)
+{
+    printHelpLine(commandContext(),WCDLI_MAX_INDENTATION_CHAR,name,description);
+}
+
+static inline const char* getDebugLevelString (WCDLI_MessageLevel_t level)
+{
+    switch (level)
+    {
+    case WCDLI_MESSAGELEVEL_FATAL:
+        return "[FAT]: ";
+    case WCDLI_MESSAGELEVEL_DANGER:
+        return "[ERR]: ";
+    case WCDLI_MESSAGELEVEL_WARNING:
+        return "[WAR]: ";
+    case WCDLI_MESSAGELEVEL_INFO:
+        return "[INF]: ";
+    case WCDLI_MESSAGELEVEL_DEBUG:
+        return "[DBG]: ";
+    case WCDLI_MESSAGELEVEL_NONE:
+        // No string!
+        return "";
+    default:
+#if defined (LIBOHIBOARD_VERSION)
+        ohiassert(0);
+#endif
+        return "";
+    }
+}
+
+/*!
+ * The time of a log message, taken when the message is written or queued.
+ */
+#if (WCDLI_LOG_TIMESTAMP > 0)
+#define WCDLI_LOG_NOW()                          WCDLI_getTimestamp()
+#else
+#define WCDLI_LOG_NOW()                          0
+#endif
+
+#if (WCDLI_LOG_TIMESTAMP > 0)
+/*!
+ * Print the time of a log message: the delta from the previous message of
+ * the console, or the absolute time to resync the reader. A message older
+ * than the previous one, queued before it was printed, has the absolute
+ * time too.
+ */
+static void printTimestamp (WCDLI_Context_t* ctx, WCDLI_FormatSink_t* sink, uint32_t timestamp)
+{
+    uint32_t delta = timestamp - ctx->logTimestamp;
+    char text[12];
+
+    if ((ctx->logTimestampSync == 0) || ((int32_t)delta < 0))
+    {
+        formatString(text,sizeof(text),"@%lu ",(unsigned long)timestamp);
+        ctx->logTimestampSync = WCDLI_LOG_TIMESTAMP_SYNC;
+    }
+    else
+    {
+        formatString(text,sizeof(text),"+%lu ",(unsigned long)delta);
+    }
+    formatPut(sink,text,strlen(text));
+    ctx->logTimestampSync--;
+    ctx->logTimestamp = timestamp;
+}
+#endif
+
+/*!
+ * Print the prompt, the level and the time of a debug message.
+ *
+ * \return FALSE when the message must not be printed in the current mode.
+ */
+static bool formatDebugHeader (WCDLI_Context_t* ctx,
+                               WCDLI_FormatSink_t* sink,
+                               WCDLI_MessageLevel_t level,
+                               uint32_t timestamp)
+{
+    const char* levelString = NULL;
+
+    if ((level != WCDLI_MESSAGELEVEL_NONE) && (ctx->operativeMode == WCDLI_OPERATIVEMODE_DEBUG))
+    {
+        levelString = getDebugLevelString(level);
+        formatPut(sink,mPromptString,strlen(mPromptString));
+        formatPut(sink,levelString,strlen(levelString));
+#if (WCDLI_LOG_TIMESTAMP > 0)
+        printTimestamp(ctx,sink,timestamp);
+#else
+        (void)timestamp;
+#endif
+    }
+    else if ((level == WCDLI_MESSAGELEVEL_NONE) && (ctx->operativeMode == WCDLI_OPERATIVEMODE_COMMAND))
+    {
+        formatPut(sink,mPromptString,strlen(mPromptString));
+        formatPut(sink,"  ",2);
+    }
+    else
+    {
+        // Exit without print anything!
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*!
+ * The staging buffer belongs to the task running the commands of the
+ * console, which prints its messages there. Any other caller builds the
+ * message on its stack, one line at most, and sends it with a single write
+ * in debugClose().
+ */
+static void debugOpen (WCDLI_Context_t* ctx, WCDLI_FormatSink_t* sink, char* line)
+{
+    sink->ctx         = (mCurrentContext == ctx) ? ctx : NULL;
+    sink->buffer      = line;
+    // Two chars are left for the new line, the sink does not need the terminator
+    sink->size        = WCDLI_MAX_CHARS_PER_LINE - 1;
+    sink->length      = 0;
+    sink->isTruncated = FALSE;
+}
+
+static void debugClose (WCDLI_Context_t* ctx, WCDLI_FormatSink_t* sink)
+{
+    if (sink->ctx != NULL)
+    {
+        return;
     }
 
-    /* Board version */
-#if defined (BOARD_VERSION_STRING)
-    memset(message,0,sizeof(message));
-    strcat(message,WCDLI_BOARD_STRING);
-    strcat(message," : ");
-    strcat(message,BOARD_VERSION_STRING);
-    if (isHello)
+    // A truncated message gets its new line back
+    if (sink->isTruncated == TRUE)
     {
-        Uart_sendStringln(mDevice, message);
+        ctx->counters.truncatedLogs++;
+        memcpy(&sink->buffer[sink->length],WCDLI_NEW_LINE,2);
+        sink->length += 2;
     }
-    else
+    sendData(ctx,(const uint8_t*)sink->buffer,sink->length);
+}
+
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+/*!
+ * Format a log message straight into a slot of the queue of the console.
+ *
+ * \param[in] timestamp: The time of the message.
+ * \param[in]       tag: The module name, or NULL.
+ * \param[in]      text: The format, or the string when argptr is NULL.
+ * \param[in]    argptr: The arguments of the format, NULL for a string to
+ *                       print with a new line.
+ * \return FALSE when the message is not a log message, and must be written
+ *         by the caller.
+ */
+static bool queueMessage (WCDLI_Context_t* ctx,
+                          WCDLI_MessageLevel_t level,
+                          uint32_t timestamp,
+                          const char* tag,
+                          const char* text,
+                          va_list* argptr)
+{
+    WCDLI_LogRecord_t* record = NULL;
+    uint32_t position = 0;
+    uint16_t length = 0;
+    uint16_t chunk = 0;
+    // Two chars are left for the new line, the sink does not need the terminator
+    WCDLI_FormatSink_t sink = {NULL, NULL, WCDLI_MAX_CHARS_PER_LINE - 1, 0, FALSE};
+
+    if (level == WCDLI_MESSAGELEVEL_NONE)
     {
-        WCDLI_debug(WCDLI_MESSAGELEVEL_NONE, message);
+        return FALSE;
     }
-#endif
 
-#if defined (FIRMWARE_VERSION_STRING) || (defined (FIRMWARE_VERSION_MAJOR) && defined (FIRMWARE_VERSION_TIME))
-#if defined (FIRMWARE_VERSION_STRING)
-    memset(message,0,sizeof(message));
-    strcat(message,WCDLI_FIRMWARE_STRING);
-    strcat(message," : ");
-    strcat(message,FIRMWARE_VERSION_STRING);
-    if (isHello)
+    // The log messages are printed in debug mode only
+    if (ctx->operativeMode != WCDLI_OPERATIVEMODE_DEBUG)
     {
-        Uart_sendStringln(mDevice, message);
+        return TRUE;
     }
-    else
+
+    record = logReserve(&ctx->logQueue,&position);
+    if (record == NULL)
     {
-        WCDLI_debug(WCDLI_MESSAGELEVEL_NONE, message);
+        return TRUE;
     }
+
+    record->level = (uint8_t)level;
+#if (WCDLI_LOG_TIMESTAMP > 0)
+    record->timestamp = timestamp;
 #else
-    char versionString[64] = {0};
-    Utility_Version_t v =
+    (void)timestamp;
+#endif
+    sink.buffer = record->text;
+    if (tag != NULL)
     {
-        .f.major    = FIRMWARE_VERSION_MAJOR,
-        .f.minor    = FIRMWARE_VERSION_MINOR,
-        .f.subminor = FIRMWARE_VERSION_SUBMINOR,
-        .f.time     = FIRMWARE_VERSION_TIME,
-    };
-    Utility_getVersionString(&v,versionString);
-    memset(message,0,sizeof(message));
-    strcat(message,WCDLI_FIRMWARE_STRING);
-    strcat(message," : ");
-    strcat(message,versionString);
-    if (isHello)
+        formatPut(&sink,tag,strlen(tag));
+        formatPut(&sink,": ",2);
+        length = sink.length;
+    }
+
+    if (argptr != NULL)
     {
-        Uart_sendStringln(mDevice, message);
+        formatv(&sink,text,*argptr);
+        if (sink.isTruncated == TRUE)
+        {
+            ctx->counters.truncatedLogs++;
+        }
+        length = sink.length;
+
+        // A record is a whole line: a truncated message gets its new line back
+        if ((length == 0) || (record->text[length-1] != '\n'))
+        {
+            memcpy(&record->text[length],WCDLI_NEW_LINE,2);
+            length += 2;
+        }
     }
     else
     {
-        WCDLI_debug(WCDLI_MESSAGELEVEL_NONE, message);
+        // A long string is truncated, the new line is always kept
+        chunk = strlen(text);
+        if (chunk > (WCDLI_MAX_CHARS_PER_LINE - 2 - length))
+        {
+            ctx->counters.truncatedLogs++;
+            chunk = WCDLI_MAX_CHARS_PER_LINE - 2 - length;
+        }
+        memcpy(&record->text[length],text,chunk);
+        length += chunk;
+        memcpy(&record->text[length],WCDLI_NEW_LINE,2);
+        length += 2;
     }
-#endif
-#else
-    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
-#endif
-}
+    record->length = length;
 
-_weak void WCDLI_printStatus (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE])
-{
-    // Intentionally empty
-    WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED();
+    logCommit(record,position);
+    WCDLI_signal(ctx);
+    return TRUE;
 }
 
-void WCDLI_ckeck (void)
+uint16_t WCDLI_processLog_ex (WCDLI_Context_t* ctx, uint16_t maxRecords)
 {
-    char c = '\0';
-    WCDLI_Command_t command = {0};
-    bool changeMode = FALSE;
+    WCDLI_FormatSink_t sink = {ctx, NULL, 0, 0, FALSE};
+    WCDLI_LogRecord_t* record = NULL;
+    uint16_t processed = 0;
+    uint32_t lost = 0;
+    uint32_t timestamp = 0;
 
-    while (!UtilityBuffer_isEmpty(&mBufferDescriptor))
+    while ((processed < maxRecords) && ((record = logPeek(&ctx->logQueue)) != NULL))
     {
-        UtilityBuffer_pull(&mBufferDescriptor,(uint8_t*)&c);
-
-        // Use the back space for delete char
-        if ((c == '\b') && (mCurrentCommandIndex > 0))
+#if (WCDLI_LOG_TIMESTAMP > 0)
+        timestamp = record->timestamp;
+#endif
+        if (formatDebugHeader(ctx,&sink,(WCDLI_MessageLevel_t)record->level,timestamp) == TRUE)
         {
-            mCurrentCommandIndex--;
-            continue;
+            writeData(ctx,(const uint8_t*)record->text,record->length);
         }
+        logRelease(&ctx->logQueue,record);
+        processed++;
+    }
 
-        if ((c == '\b') && (mCurrentCommandIndex == 0))
-        {
-            continue;
-        }
+    // The losses are reported after the messages sent before them
+    lost = (record == NULL) ? WCDLI_ATOMIC_LOAD(&ctx->logQueue.lost) : 0;
+    while ((lost > 0) && !WCDLI_ATOMIC_CAS(&ctx->logQueue.lost,&lost,0))
+    {
+        // A producer counted another loss
+    }
+    if ((lost > 0) && (formatDebugHeader(ctx,&sink,WCDLI_MESSAGELEVEL_WARNING,WCDLI_LOG_NOW()) == TRUE))
+    {
+        writeFormat(ctx,"%lu log messages lost" WCDLI_NEW_LINE,(unsigned long)lost);
+    }
 
-        mCurrentCommand[mCurrentCommandIndex++] = c;
+    writeFlush(ctx);
+    return processed;
+}
 
-        if ((mCurrentCommandIndex != 0) &&
-            (mCurrentCommand[mCurrentCommandIndex-2] == '\r') &&
-            (mCurrentCommand[mCurrentCommandIndex-1] == '\n'))
-        {
-            // parse command
+uint16_t WCDLI_processLog (uint16_t maxRecords)
+{
+    return WCDLI_processLog_ex(WCDLI_mainContext,maxRecords);
+}
+#endif // WCDLI_LOG_QUEUE_SLOTS
 
-            // No message, only enter command!
-            if (mCurrentCommandIndex == 2)
-            {
-                prompt();
-                return;
-            }
+void WCDLI_debug_ex (WCDLI_Context_t* ctx, WCDLI_MessageLevel_t level, const char* str)
+{
+    char line[WCDLI_MAX_CHARS_PER_LINE];
+    WCDLI_FormatSink_t sink;
+    uint32_t timestamp = 0;
 
-            //WCDLI_PRINT_NEW_LINE();
-            parseCommand(&command, &changeMode);
+    if (level > ctx->debugLevel)
+    {
+        return;
+    }
+    timestamp = WCDLI_LOG_NOW();
 
-            if (command.name != NULL)
-            {
-                if (changeMode == FALSE)
-                {
-                    // Parse params
-                    parseParams();
-                    command.callback(command.device, mNumberOfParams, mParams);
-                }
-                else
-                {
-                    // TODO
-                }
-            }
-            else
-            {
-                if (mOperativeMode == WCDLI_OPERATIVEMODE_COMMAND)
-                {
-                    // Command not found!
-                    WCDLI_PRINT_NO_COMMAND();
-                }
-            }
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    if (queueMessage(ctx,level,timestamp,NULL,str,NULL) == TRUE)
+    {
+        return;
+    }
+#endif
 
-            if (mOperativeMode == WCDLI_OPERATIVEMODE_COMMAND)
-            {
-                prompt();
-            }
-            break;
-        }
-        else
-        {
-            continue;
-        }
+    debugOpen(ctx,&sink,line);
+    if (formatDebugHeader(ctx,&sink,level,timestamp) == TRUE)
+    {
+        // Print string...
+        formatPut(&sink,str,strlen(str));
+        formatPut(&sink,WCDLI_NEW_LINE,2);
+        debugClose(ctx,&sink);
     }
 }
 
-#if defined (LIBOHIBOARD_VERSION)
-void WCDLI_init (Uart_DeviceHandle dev)
-#else
-#if defined (__MCUXPRESSO)
-#if defined (__MCUXPRESSO_UART)
-void WCDLI_init (UART_Type* dev)
-#elif defined (__MCUXPRESSO_USART)
-void WCDLI_init (USART_Type* dev)
-#endif
-#elif defined (__NUECLIPSE)
-void WCDLI_init (UART_T* dev)
-#endif
-#endif
+void WCDLI_debug (WCDLI_MessageLevel_t level, const char* str)
 {
-    if (dev == NULL)
+    WCDLI_debug_ex(debugContext(level),level,str);
+}
+
+static void debugByFormat (WCDLI_Context_t* ctx, WCDLI_MessageLevel_t level, const char* format, va_list argptr)
+{
+    char line[WCDLI_MAX_CHARS_PER_LINE];
+    WCDLI_FormatSink_t sink;
+    uint32_t timestamp = 0;
+
+    if (level > ctx->debugLevel)
+    {
+        return;
+    }
+    timestamp = WCDLI_LOG_NOW();
+
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    // A copy: the address of a va_list parameter is not a va_list pointer on every ABI
+    va_list arguments;
+    va_copy(arguments,argptr);
+    bool isQueued = queueMessage(ctx,level,timestamp,NULL,format,&arguments);
+    va_end(arguments);
+    if (isQueued == TRUE)
     {
-#if defined (LIBOHIBOARD_VERSION)
-        ohiassert(0);
-#else
-        assert(0);
-#endif
         return;
     }
-    // Save device handle
-    mDevice = dev;
-#if defined (LIBOHIBOARD_VERSION)
-    Uart_addRxCallback(mDevice,callbackRx);
-#else
-    // This association is external...
 #endif
 
-    // Initialize buffer descriptor
-    UtilityBuffer_init(&mBufferDescriptor,(uint8_t*)mBuffer,WCDLI_BUFFER_DIMENSION+1);
-
-//    strcat(mPromptString,WCDLI_NEW_LINE);
-    mPromptString[strlen(mPromptString)] = WCDLI_PROMPT_CHAR;
-    strcat(mPromptString,"> ");
+    debugOpen(ctx,&sink,line);
+    if (formatDebugHeader(ctx,&sink,level,timestamp) == TRUE)
+    {
+        // Print string...
+        formatv(&sink,format,argptr);
+        debugClose(ctx,&sink);
+    }
+}
 
-    // Send Hello World!
-    sayHello();
-    prompt();
+void WCDLI_debugByFormat_ex (WCDLI_Context_t* ctx, WCDLI_MessageLevel_t level, const char* format, ...)
+{
+    va_list argptr;
+    va_start(argptr,format);
+    debugByFormat(ctx,level,format,argptr);
+    va_end(argptr);
+}
 
+void WCDLI_debugByFormat (WCDLI_MessageLevel_t level, const char* format, ...)
+{
+    va_list argptr;
+    va_start(argptr,format);
+    debugByFormat(debugContext(level),level,format,argptr);
+    va_end(argptr);
 }
 
-WCDLI_Error_t WCDLI_addCommandByParam (const char* name,
-                                       const char* description,
-                                       WCDLI_CommandCallback_t callback)
+WCDLI_Error_t WCDLI_addModule (const char* name,
+                               WCDLI_MessageLevel_t level,
+                               WCDLI_Module_t* module)
 {
-#if defined (LIBOHIBOARD_VERSION)
-    ohiassert(callback != NULL);
-#endif
+    WCDLI_Module_t found = 0;
 
-    if (callback == NULL)
+    if ((name == NULL) || (module == NULL) || (level > WCDLI_MESSAGELEVEL_ALL))
     {
-        return WCDLI_ERROR_EMPTY_CALLBACK;
+        return WCDLI_ERROR_WRONG_PARAMS;
     }
 
-    if (mExternalCommandsIndex < WCDLI_MAX_EXTERNAL_COMMAND)
+    if ((mModulesSize == WCDLI_MAX_MODULES) || (findModule(name,&found) == TRUE))
     {
-        mExternalCommands[mExternalCommandsIndex].name        = name;
-        mExternalCommands[mExternalCommandsIndex].description = description;
-
-        mExternalCommands[mExternalCommandsIndex].device      = 0;
-        mExternalCommands[mExternalCommandsIndex].callback    = callback;
+        return WCDLI_ERROR_ADD_MODULE_FAIL;
+    }
 
-        mExternalCommandsIndex++;
+    mModuleNames[mModulesSize] = name;
+    WCDLI_moduleLevels[mModulesSize] = level;
+    *module = mModulesSize++;
+    return WCDLI_ERROR_SUCCESS;
+}
 
-        return WCDLI_ERROR_SUCCESS;
-    }
-    else
+void WCDLI_setModuleLevel (WCDLI_Module_t module, WCDLI_MessageLevel_t level)
+{
+    if ((module < mModulesSize) && (level <= WCDLI_MESSAGELEVEL_ALL))
     {
-        return WCDLI_ERROR_ADD_COMMAND_FAIL;
+        WCDLI_moduleLevels[module] = level;
     }
 }
 
-WCDLI_Error_t WCDLI_addCommand (WCDLI_Command_t* command)
+void WCDLI_debugModuleByFormat (WCDLI_Module_t module,
+                                WCDLI_MessageLevel_t level,
+                                const char* format, ...)
 {
-#if defined (LIBOHIBOARD_VERSION)
-    ohiassert(command != NULL);
-#endif
+    WCDLI_Context_t* ctx = debugContext(level);
+    char line[WCDLI_MAX_CHARS_PER_LINE];
+    WCDLI_FormatSink_t sink;
+    uint32_t timestamp = 0;
+    va_list argptr;
 
-    if (command != NULL)
+    if ((module >= mModulesSize) || (level > WCDLI_moduleLevels[module]))
     {
-        return WCDLI_addCommandByParam(command->name, command->description, command->callback);
+        return;
     }
+    timestamp = WCDLI_LOG_NOW();
 
-    return WCDLI_ERROR_ADD_COMMAND_FAIL;
-}
-
-WCDLI_Error_t WCDLI_addAppByParam (const char* name,
-                                   const char* description,
-                                   void* app,
-                                   WCDLI_CommandCallback_t callback)
-{
-#if defined (LIBOHIBOARD_VERSION)
-    ohiassert(callback != NULL);
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    va_start(argptr,format);
+    bool isQueued = queueMessage(ctx,level,timestamp,mModuleNames[module],format,&argptr);
+    va_end(argptr);
+    if (isQueued == TRUE)
+    {
+        return;
+    }
 #endif
 
-    if (callback == NULL)
+    debugOpen(ctx,&sink,line);
+    if (formatDebugHeader(ctx,&sink,level,timestamp) == TRUE)
     {
-        return WCDLI_ERROR_EMPTY_CALLBACK;
+        // Print module tag and string...
+        formatPut(&sink,mModuleNames[module],strlen(mModuleNames[module]));
+        formatPut(&sink,": ",2);
+        va_start(argptr,format);
+        formatv(&sink,format,argptr);
+        va_end(argptr);
+        debugClose(ctx,&sink);
     }
+}
 
-    if (mExternalAppsIndex < WCDLI_MAX_EXTERNAL_APP)
-    {
-        mExternalApps[mExternalAppsIndex].name        = name;
-        mExternalApps[mExternalAppsIndex].description = description;
+#if (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
 
-        mExternalApps[mExternalAppsIndex].device      = app;
-        mExternalApps[mExternalAppsIndex].callback    = callback;
+#define WCDLI_DEFERRED_RECORD_MAX_SIZE           (1 + sizeof(uintptr_t) + 4 + (4 * WCDLI_DEFERRED_MAX_ARGS))
 
-        mExternalAppsIndex++;
+void WCDLI_debugDeferred (WCDLI_MessageLevel_t level, const char* format, uint8_t argc, ...)
+{
+    uint8_t record[WCDLI_DEFERRED_RECORD_MAX_SIZE];
+    uintptr_t id = (uintptr_t)format;
+    uint32_t word = 0;
+    uint16_t length = 0;
 
-        return WCDLI_ERROR_SUCCESS;
-    }
-    else
+    if (level > WCDLI_mainContext->debugLevel)
     {
-        return WCDLI_ERROR_ADD_APP_FAIL;
+        return;
     }
-}
 
-WCDLI_Error_t WCDLI_addApp (WCDLI_Command_t* app)
-{
-#if defined (LIBOHIBOARD_VERSION)
-    ohiassert(app != NULL);
-#endif
+    if (argc > WCDLI_DEFERRED_MAX_ARGS)
+    {
+        argc = WCDLI_DEFERRED_MAX_ARGS;
+    }
 
-    if (app != NULL)
+    record[0] = (uint8_t)level | (argc << WCDLI_DEFERRED_HEADER_ARGC_SHIFT);
+    if (sizeof(uintptr_t) > 4)
     {
-        return WCDLI_addAppByParam(app->name,
-                                   app->description,
-                                   app->device,
-                                   app->callback);
+        record[0] |= WCDLI_DEFERRED_HEADER_WIDE_ID;
     }
+    memcpy(&record[1],&id,sizeof(id));
+    length = 1 + sizeof(id);
 
-    return WCDLI_ERROR_ADD_APP_FAIL;
-}
+    word = WCDLI_getTimestamp();
+    memcpy(&record[length],&word,4);
+    length += 4;
 
-void WCDLI_helpLine (const char* name, const char* description)
-{
-    uint8_t noBlank = 0;
-    uint8_t c = ' ';
+    va_list argptr;
+    va_start(argptr,argc);
+    for (uint8_t i = 0; i < argc; ++i)
+    {
+        word = va_arg(argptr,uint32_t);
+        memcpy(&record[length],&word,4);
+        length += 4;
+    }
+    va_end(argptr);
 
-    noBlank = WCDLI_MAX_CHARS_COMMAND_LINE - strlen(name) - WCDLI_MAX_INDENTATION_CHAR;
-    for (uint8_t i=0; i < WCDLI_MAX_INDENTATION_CHAR; ++i)
+    // The producers can be tasks and interrupts: the record is written whole
+    WCDLI_ENTER_CRITICAL();
+    if (ringFree(&mDeferredRing) >= length)
     {
-        Uart_write(mDevice,&c,100);
+        ringWrite(&mDeferredRing,record,length);
     }
-    Uart_sendString(mDevice,name);
-    for (uint8_t i=0; i < noBlank; ++i)
+    else
     {
-        Uart_write(mDevice,&c,100);
+        mDeferredLost++;
     }
-    c = WCDLI_DIVIDING_DESCRIPTION_CHAR;
-    Uart_write(mDevice,&c,100);
-    c = ' ';
-    Uart_write(mDevice,&c,100);
-    Uart_sendStringln(mDevice,description);
+    WCDLI_EXIT_CRITICAL();
+
+    WCDLI_signal(WCDLI_mainContext);
 }
 
-static inline void getDebugLevelString (WCDLI_MessageLevel_t level, char* ascii)
+/*!
+ * Print the number of the lost messages, or send it to the host decoder as
+ * a record of level WCDLI_DEFERRED_HEADER_LOST.
+ */
+static void reportDeferredLost (WCDLI_Context_t* ctx, WCDLI_FormatSink_t* sink)
 {
-    switch (level)
+    static const uint8_t sync[2] = {WCDLI_DEFERRED_SYNC_0, WCDLI_DEFERRED_SYNC_1};
+    uint8_t record[1 + sizeof(uintptr_t) + 4 + 4] = {0};
+    uint32_t timestamp = WCDLI_getTimestamp();
+    uint32_t lost = 0;
+
+    // The producers count the losses in their critical section
     {
-    case WCDLI_MESSAGELEVEL_FATAL:
-        strcpy(ascii,"[FAT]: ");
-        break;
-    case WCDLI_MESSAGELEVEL_DANGER:
-        strcpy(ascii,"[ERR]: ");
-        break;
-    case WCDLI_MESSAGELEVEL_WARNING:
-        strcpy(ascii,"[WAR]: ");
-        break;
-    case WCDLI_MESSAGELEVEL_INFO:
-        strcpy(ascii,"[INF]: ");
-        break;
-    case WCDLI_MESSAGELEVEL_DEBUG:
-        strcpy(ascii,"[DBG]: ");
-        break;
-    case WCDLI_MESSAGELEVEL_NONE:
-        // No string!
-        break;
-    default:
-#if defined (LIBOHIBOARD_VERSION)
-        ohiassert(0);
-#endif
-        break;
+        WCDLI_ENTER_CRITICAL();
+        lost = mDeferredLost;
+        mDeferredLost = 0;
+        WCDLI_EXIT_CRITICAL();
     }
-}
 
-void WCDLI_debug (WCDLI_MessageLevel_t level, const char* str)
-{
-    char buffer[WCDLI_MAX_CHARS_PER_LINE] = {0};
-
-    if (level <= mDebugLevel)
+    if (lost == 0)
     {
-        strcat(buffer,mPromptString);
+        return;
+    }
 
-        if ((level != WCDLI_MESSAGELEVEL_NONE) && (mOperativeMode == WCDLI_OPERATIVEMODE_DEBUG))
-        {
-            getDebugLevelString(level,&buffer[strlen(mPromptString)]);
-        }
-        else if ((level == WCDLI_MESSAGELEVEL_NONE) && (mOperativeMode == WCDLI_OPERATIVEMODE_COMMAND))
-        {
-            strcat(buffer,"  ");
-        }
-        else
+    if (mDeferredOutput == WCDLI_DEFERRED_OUTPUT_BINARY)
+    {
+        record[0] = WCDLI_DEFERRED_HEADER_LOST | (1u << WCDLI_DEFERRED_HEADER_ARGC_SHIFT);
+        if (sizeof(uintptr_t) > 4)
         {
-            // Exit without print anything!
-            return;
+            record[0] |= WCDLI_DEFERRED_HEADER_WIDE_ID;
         }
-
-        strcat(buffer,str);
-        // Print string...
-        Uart_sendStringln(mDevice,buffer);
+        memcpy(&record[1 + sizeof(uintptr_t)],&timestamp,4);
+        memcpy(&record[1 + sizeof(uintptr_t) + 4],&lost,4);
+        writeData(ctx,sync,sizeof(sync));
+        writeData(ctx,record,sizeof(record));
+    }
+    else if (formatDebugHeader(ctx,sink,WCDLI_MESSAGELEVEL_WARNING,timestamp) == TRUE)
+    {
+        writeFormat(ctx,"%lu deferred messages lost" WCDLI_NEW_LINE,(unsigned long)lost);
     }
 }
 
-void WCDLI_debugByFormat (WCDLI_MessageLevel_t level, const char* format, ...)
+uint16_t WCDLI_processDeferred (uint16_t maxRecords)
 {
-	// Delete space for message level...
-    char buffer[WCDLI_MAX_CHARS_PER_LINE] = {0};
-    char msgLevel[20] = {0};
-
-    if (level <= mDebugLevel)
+    WCDLI_Context_t* ctx = WCDLI_mainContext;
+    WCDLI_FormatSink_t sink = {ctx, NULL, 0, 0, FALSE};
+    static const uint8_t sync[2] = {WCDLI_DEFERRED_SYNC_0, WCDLI_DEFERRED_SYNC_1};
+    uint8_t record[WCDLI_DEFERRED_RECORD_MAX_SIZE];
+    // The formatter is always given 8 words, whatever WCDLI_DEFERRED_MAX_ARGS
+    uint32_t args[8] = {0};
+    uint32_t timestamp = 0;
+    uintptr_t id = 0;
+    uint16_t length = 0;
+    uint16_t processed = 0;
+    uint8_t argc = 0;
+    WCDLI_MessageLevel_t level = WCDLI_MESSAGELEVEL_NONE;
+
+    while ((processed < maxRecords) && (ringCount(&mDeferredRing) > 0))
     {
-        va_list argptr;
-        va_start(argptr,format);
-        vsnprintf(buffer,WCDLI_MAX_CHARS_PER_LINE,format,argptr);
-        va_end(argptr);
-
-        // Print prompt chars
-        strcat(msgLevel,mPromptString);
-
-        // Print string...
-        if ((level != WCDLI_MESSAGELEVEL_NONE) && (mOperativeMode == WCDLI_OPERATIVEMODE_DEBUG))
-        {
-            // Get message level string
-            getDebugLevelString(level,&msgLevel[strlen(mPromptString)]);
-        }
-        else if ((level == WCDLI_MESSAGELEVEL_NONE) && (mOperativeMode == WCDLI_OPERATIVEMODE_COMMAND))
+        ringRead(&mDeferredRing,record,1);
+        level = (WCDLI_MessageLevel_t)(record[0] & WCDLI_DEFERRED_HEADER_LEVEL_MASK);
+        argc = (record[0] & WCDLI_DEFERRED_HEADER_ARGC_MASK) >> WCDLI_DEFERRED_HEADER_ARGC_SHIFT;
+        length = 1 + sizeof(id) + 4 + (4 * argc);
+        ringRead(&mDeferredRing,&record[1],length - 1);
+        processed++;
+
+        if (mDeferredOutput == WCDLI_DEFERRED_OUTPUT_BINARY)
         {
-            strcat(msgLevel,"  ");
+            // The host decoder does the formatting
+            writeData(ctx,sync,sizeof(sync));
+            writeData(ctx,record,length);
+            continue;
         }
-        else
+
+        memcpy(&timestamp,&record[1 + sizeof(id)],4);
+        if (formatDebugHeader(ctx,&sink,level,timestamp) == TRUE)
         {
-            // Exit without print anything!
-            return;
+            memcpy(&id,&record[1],sizeof(id));
+            memset(args,0,sizeof(args));
+            memcpy(args,&record[1 + sizeof(id) + 4],4 * argc);
+            // Unused arguments are ignored by the formatter
+            writeFormat(ctx,(const char*)id,
+                        args[0],args[1],args[2],args[3],
+                        args[4],args[5],args[6],args[7]);
         }
+    }
 
-        Uart_sendString(mDevice,msgLevel);
-        Uart_sendString(mDevice,buffer);
+    // The losses are reported after the messages sent before them
+    if ((mDeferredOutput == WCDLI_DEFERRED_OUTPUT_BINARY) ||
+        (ctx->operativeMode == WCDLI_OPERATIVEMODE_DEBUG))
+    {
+        reportDeferredLost(ctx,&sink);
     }
+
+    writeFlush(ctx);
+    return processed;
 }
 
+void WCDLI_setDeferredOutput (WCDLI_DeferredOutput_t output)
+{
+    mDeferredOutput = output;
+}
+
+#endif // WCDLI_DEFERRED_BUFFER_DIMENSION
+
 #ifdef __cplusplus
 }
 #endif
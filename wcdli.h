@@ -79,6 +79,146 @@ extern "C"
 #endif
 #elif defined (__NUECLIPSE)
 #include "uart.h"
+#elif defined (__POSIX_HOST)
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+#endif
+
+#if defined (__POSIX_HOST)
+/*!
+ * Serial device of the POSIX host backend: the bytes are read from and
+ * written to file descriptors, so stdio, a pseudo-terminal or a socketpair
+ * can be used in place of the UART.
+ */
+typedef struct _WCDLI_HostDevice_t
+{
+    int rx;                   /*!< Descriptor of the incoming bytes */
+    int tx;                   /*!< Descriptor of the outgoing bytes */
+    int peer;                 /*!< The other end of a pty or socketpair, -1 with stdio */
+    volatile bool isRxReady;  /*!< The emulated RTS line, or the last XON/XOFF sent */
+} WCDLI_HostDevice_t;
+#endif
+
+/*!
+ * Handle of the serial peripheral of a console.
+ */
+#if defined (LIBOHIBOARD_VERSION)
+typedef Uart_DeviceHandle WCDLI_Device_t;
+#elif defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+typedef UART_Type* WCDLI_Device_t;
+#elif defined (__MCUXPRESSO_USART)
+typedef USART_Type* WCDLI_Device_t;
+#endif
+#elif defined (__NUECLIPSE)
+typedef UART_T* WCDLI_Device_t;
+#elif defined (__POSIX_HOST)
+typedef WCDLI_HostDevice_t* WCDLI_Device_t;
+#endif
+
+/*!
+ * The state of a console: every serial peripheral running a command line
+ * has its own context, while the commands, the apps and the modules are
+ * shared by all the consoles.
+ *
+ * \note The fields are private, use the _ex APIs.
+ */
+typedef struct _WCDLI_Context_t
+{
+    WCDLI_Device_t device;
+
+    uint8_t rxBuffer[WCDLI_BUFFER_DIMENSION+1];     /*!< The incoming bytes */
+    WCDLI_Ring_t rxRing;
+
+    uint32_t currentCommandIndex;
+    char currentCommand[WCDLI_MAX_CHARS_PER_LINE];
+    const char* params[WCDLI_MAX_PARAMS];           /*!< Pointers into currentCommand */
+    uint8_t numberOfParams;
+
+    volatile uint16_t rxEvents;                     /*!< Lines signalled by the RX interrupt */
+    uint16_t rxHandled;                             /*!< Lines handled by WCDLI_ckeck() */
+    uint16_t rxLength;                              /*!< Bytes received after the last line */
+    uint16_t rxCircularPosition;                    /*!< Next byte of the circular DMA buffer */
+    WCDLI_FlowControl_t flowControl;
+    volatile bool isRxPaused;                       /*!< The remote was asked to pause */
+
+    WCDLI_OperativeMode_t operativeMode;
+    WCDLI_MessageLevel_t debugLevel;
+
+    bool isBatch;                                   /*!< No prompts up to the end of the batch */
+    uint16_t batchCommands;
+    uint16_t batchErrors;                           /*!< Commands not found or ambiguous */
+
+    bool isResponseOpen;                            /*!< A command streams its response */
+
+    bool isRunning;                                 /*!< A resumable command is running */
+    WCDLI_Command_t runningCommand;
+    WCDLI_CommandRun_t run;
+    volatile bool isCancelRequested;                /*!< Ctrl-C received */
+    uint16_t busyEvents;                            /*!< Lines told to wait */
+    char* nextCommand;                              /*!< The rest of the running line */
+    char* lineEnd;
+#if (WCDLI_PROFILING > 0)
+    WCDLI_CommandStats_t* runStats;                 /*!< The profile of the running command */
+    uint32_t runCycles;                             /*!< Its duration up to now */
+#endif
+
+    WCDLI_Counters_t counters;
+
+    uint8_t output[WCDLI_OUTPUT_BUFFER_DIMENSION];  /*!< The staged output */
+    uint16_t outputIndex;
+    WCDLI_OutputFlushPolicy_t outputFlushPolicy;
+
+#if (WCDLI_TX_BUFFER_DIMENSION > 0)
+    uint8_t txBuffer[WCDLI_TX_BUFFER_DIMENSION+1];
+    WCDLI_Ring_t txRing;
+    volatile WCDLI_TxOverflowPolicy_t txOverflowPolicy;
+#if defined (__POSIX_HOST)
+    pthread_t txThread;
+    pthread_mutex_t txMutex;
+    pthread_cond_t txEvent;
+    bool txPending;
+#endif
+#endif
+
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+    WCDLI_LogQueue_t logQueue;                      /*!< The log messages to print */
+#endif
+#if (WCDLI_LOG_TIMESTAMP > 0)
+    uint32_t logTimestamp;                          /*!< Time of the last message printed */
+    uint16_t logTimestampSync;                      /*!< Messages up to the next absolute time */
+#endif
+
+#if defined (__POSIX_HOST)
+    uint8_t lastRx;
+    int signal[2];                                  /*!< Pipe written by WCDLI_signal() */
+#endif
+#if defined (LIBOHIBOARD_VERSION)
+    struct _WCDLI_Context_t* next;                  /*!< To find the context of a device */
+#endif
+} WCDLI_Context_t;
+
+/*!
+ * The first initialized console, used by the APIs without _ex suffix. The
+ * answers of the commands (level WCDLI_MESSAGELEVEL_NONE), the help lines and
+ * the responses go to the console running the command, the logs always go
+ * here.
+ */
+extern WCDLI_Context_t* WCDLI_mainContext;
+
+/*!
+ * The storage of the console running a command. Every task checking a
+ * console needs its own copy: thread-local on the host, to be defined as the
+ * thread-local keyword of the RTOS when consoles are checked by different
+ * tasks.
+ */
+#if !defined (WCDLI_THREAD_LOCAL)
+#if defined (__POSIX_HOST)
+#define WCDLI_THREAD_LOCAL                       __thread
+#else
+#define WCDLI_THREAD_LOCAL
 #endif
 #endif
 
@@ -115,11 +255,27 @@ void WCDLI_init (USART_Type* dev);
 #endif
 #elif defined (__NUECLIPSE)
 void WCDLI_init (UART_T* dev);
+#elif defined (__POSIX_HOST)
+void WCDLI_init (WCDLI_HostDevice_t* dev);
 #else
 #error "[ERROR] Peripheral not defined!"
 #endif
 #endif
 
+/*!
+ * Initialize a console on its own peripheral: several consoles can run side
+ * by side, each one checked with WCDLI_ckeck_ex().
+ *
+ * \param[out] ctx: The context of the console.
+ * \param[in]  dev: The peripheral device handle to use.
+ */
+void WCDLI_init_ex (WCDLI_Context_t* ctx, WCDLI_Device_t dev);
+
+/*!
+ * The interrupt handlers pass the context of the console as obj, NULL for
+ * the console initialized by WCDLI_init(). The RX handler drains the whole
+ * FIFO of the peripheral at every call.
+ */
 #if !defined (LIBOHIBOARD_VERSION)
 #if defined (__MCUXPRESSO)
 #if defined (__MCUXPRESSO_UART)
@@ -129,34 +285,368 @@ void WCDLI_callbackRx (USART_Type* base, void* obj);
 #endif
 #elif defined (__NUECLIPSE)
 void WCDLI_callbackRx (UART_T* base, void* obj);
+#elif defined (__POSIX_HOST)
+/*!
+ * Read all the available bytes of the device, without blocking.
+ */
+void WCDLI_callbackRx (WCDLI_HostDevice_t* base, void* obj);
 #else
 #error "[ERROR] Peripheral callback not defined!"
 #endif
 #endif
 
+/*!
+ * Store a span of received bytes, as the RX interrupt does for each byte:
+ * for a DMA, an idle line interrupt or a driver that reads many bytes at
+ * once. It must not run at the same time as the RX interrupt of the console.
+ *
+ * \param[in]   data: The received bytes.
+ * \param[in] length: The number of bytes.
+ */
+void WCDLI_feed (const uint8_t* data, size_t length);
+void WCDLI_feed_ex (WCDLI_Context_t* ctx, const uint8_t* data, size_t length);
 
 /*!
- * \defgroup WCDLI_Command WC&DLI Command APIs
+ * Store the bytes written by a circular DMA since the last call: call it from
+ * the idle line, half transfer and transfer complete interrupts. The buffer
+ * must be read before the DMA comes back to the last position.
+ *
+ * \param[in]   buffer: The buffer of the DMA.
+ * \param[in]     size: The dimension of the buffer.
+ * \param[in] position: The next byte the DMA writes, that is the size minus
+ *                      the remaining transfers.
+ */
+void WCDLI_feedCircular (const uint8_t* buffer, uint16_t size, uint16_t position);
+void WCDLI_feedCircular_ex (WCDLI_Context_t* ctx, const uint8_t* buffer, uint16_t size, uint16_t position);
+
+/*!
+ * \param[in] mode: How the remote is paused when the RX ring fills up.
+ */
+void WCDLI_setFlowControl (WCDLI_FlowControl_t mode);
+void WCDLI_setFlowControl_ex (WCDLI_Context_t* ctx, WCDLI_FlowControl_t mode);
+
+/*!
+ * Pause or restart the remote: called from the RX interrupt when the RX
+ * ring reaches WCDLI_RX_HIGH_WATERMARK, and from WCDLI_ckeck() when it is
+ * drained. The default implementation sends XOFF and XON; the RTS line has
+ * no portable driver, so it must be overridden to drive the pin. On the
+ * host it also sets dev->isRxReady, and the device is not read while the
+ * remote is paused, as a remote that honours the flow control.
+ *
+ * \param[in]     ctx: The context of the console.
+ * \param[in] isReady: FALSE to pause the remote, TRUE to restart it.
+ */
+void WCDLI_setRxFlow (WCDLI_Context_t* ctx, bool isReady);
+
+#if defined (__POSIX_HOST)
+/*!
+ * \defgroup WCDLI_Host WC&DLI POSIX host backend
  * \{
  */
 
 /*!
+ * Use the standard input and output.
  *
+ * \param[out] dev:
+ * \return 0 on success, -1 otherwise.
  */
-void WCDLI_printProjectVersion (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
+int WCDLI_hostOpenStdio (WCDLI_HostDevice_t* dev);
 
 /*!
+ * Open a pseudo-terminal in raw mode: a terminal program can be connected
+ * to the slave side, whose name is returned by WCDLI_hostGetPtyName().
  *
+ * \param[out] dev:
+ * \return 0 on success, -1 otherwise.
  */
-void WCDLI_printStatus (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
+int WCDLI_hostOpenPty (WCDLI_HostDevice_t* dev);
 
-void WCDLI_save (void* app, int argc, char argv[][WCDLI_BUFFER_SIZE]);
+/*!
+ * \param[in] dev:
+ * \return The name of the slave side of the pseudo-terminal.
+ */
+const char* WCDLI_hostGetPtyName (WCDLI_HostDevice_t* dev);
+
+/*!
+ * Open a socketpair: the other end, dev->peer, plays the role of the remote
+ * terminal, for tests and benchmarks.
+ *
+ * \param[out] dev:
+ * \return 0 on success, -1 otherwise.
+ */
+int WCDLI_hostOpenSocketpair (WCDLI_HostDevice_t* dev);
+
+/*!
+ * \}
+ */
+#endif
+
+
+/*!
+ * \defgroup WCDLI_Event WC&DLI Event APIs
+ * \{
+ *
+ * The RX interrupt counts the complete lines, so WCDLI_ckeck() parses only
+ * when a line is ready, and calls WCDLI_signal(). An application without
+ * work to do sleeps into WCDLI_wait() in place of polling WCDLI_ckeck():
+ *
+ *     for (;;)
+ *     {
+ *         WCDLI_wait(100);
+ *         WCDLI_ckeck();
+ *     }
+ *
+ * With an RTOS, override WCDLI_signal() to give a semaphore or set an event
+ * flag, and WCDLI_waitSignal() to take it.
+ */
+
+/*!
+ * Wait forever into WCDLI_wait().
+ */
+#define WCDLI_WAIT_FOREVER                       0xFFFFFFFFul
+
+/*!
+ * \return TRUE when a line is ready to be parsed.
+ */
+bool WCDLI_isLineReady (void);
+bool WCDLI_isLineReady_ex (WCDLI_Context_t* ctx);
+
+/*!
+ * Wait until there is work for WCDLI_ckeck(): a complete line, a queued log
+ * message or a deferred message.
+ *
+ * \param[in] timeout: Max time to wait, in milliseconds.
+ * \return TRUE when there is work, FALSE on timeout.
+ */
+bool WCDLI_wait (uint32_t timeout);
+bool WCDLI_wait_ex (WCDLI_Context_t* ctx, uint32_t timeout);
+
+/*!
+ * Wake the console: called by the RX interrupt at the end of a line (or
+ * when a line fills WCDLI_MAX_CHARS_PER_LINE) and by the producers of log
+ * messages, so it must be safe from an interrupt. The default
+ * implementation does nothing on the microcontrollers, where the interrupt
+ * itself ends the sleep, and writes into a pipe on the POSIX host.
+ *
+ * \param[in] ctx: The console with work to do.
+ */
+void WCDLI_signal (WCDLI_Context_t* ctx);
+
+/*!
+ * Sleep until WCDLI_signal() or the timeout. The default implementation
+ * sleeps with WFI: with libohiboard the system tick measures the timeout,
+ * on the other microcontrollers the cycle counter or, on the cores without
+ * it, the running SysTick with its interrupt, at SystemCoreClock. Without
+ * both it returns at the first interrupt. On the POSIX host it polls the
+ * pipe of WCDLI_signal() and the device, reading the incoming bytes itself.
+ *
+ * \param[in]     ctx: The console.
+ * \param[in] timeout: Max time to wait, in milliseconds.
+ */
+void WCDLI_waitSignal (WCDLI_Context_t* ctx, uint32_t timeout);
+
+#if defined (__POSIX_HOST)
+/*!
+ * \param[in] ctx: The console.
+ * \return The descriptor readable after WCDLI_signal(), for the poll loop of
+ *         the application. WCDLI_ckeck() empties it.
+ */
+int WCDLI_hostGetSignalFd (WCDLI_Context_t* ctx);
+#endif
+
+/*!
+ * \}
+ */
+
+/*!
+ * Send the staged output and wait until it is on the wire.
+ */
+void WCDLI_flush (void);
+void WCDLI_flush_ex (WCDLI_Context_t* ctx);
+
+/*!
+ * The output is assembled into a staging buffer and handed to the transport
+ * with a single write: when a new line is staged, when the staged bytes reach
+ * WCDLI_OUTPUT_FLUSH_THRESHOLD, or only with WCDLI_flush(). The staged
+ * output is always sent with the prompt and at every WCDLI_ckeck() call.
+ *
+ * The staging buffer belongs to the task calling WCDLI_ckeck_ex(): the
+ * commands, the responses and WCDLI_flush() write it from there. The debug
+ * APIs can be called by any task: out of the commands of the console they
+ * build the message on the caller's stack, one line of
+ * WCDLI_MAX_CHARS_PER_LINE at most, and send it with a single write. The
+ * interrupts use WCDLI_debugDeferred().
+ *
+ * \param[in] policy: The flush policy.
+ */
+void WCDLI_setOutputFlushPolicy (WCDLI_OutputFlushPolicy_t policy);
+void WCDLI_setOutputFlushPolicy_ex (WCDLI_Context_t* ctx, WCDLI_OutputFlushPolicy_t policy);
+
+/*!
+ * \defgroup WCDLI_Response WC&DLI Streaming response APIs
+ * \{
+ *
+ * A command with a long answer opens a response and writes chunks of any
+ * length, with no line limit. With the TX ring the write never waits: it
+ * takes the bytes that fit, and the command writes the rest later, for
+ * instance from the next call of a resumable command or from another task
+ * with the _ex APIs and the context saved from WCDLI_currentContext().
+ * Without the ring the writes are blocking and take every byte. The APIs
+ * without _ex suffix use the console running the command. While the
+ * response is open the new lines of the console wait, and the prompt is
+ * printed when it is closed.
+ *
+ * \note With libohiboard the TX ring is drained by WCDLI_ckeck().
+ */
+
+void WCDLI_openResponse (void);
+void WCDLI_openResponse_ex (WCDLI_Context_t* ctx);
+
+/*!
+ * \param[in]   data: The bytes of the response.
+ * \param[in] length: The number of bytes.
+ * \return The number of bytes taken, zero when the write would block.
+ */
+uint16_t WCDLI_writeResponse (const uint8_t* data, uint16_t length);
+uint16_t WCDLI_writeResponse_ex (WCDLI_Context_t* ctx, const uint8_t* data, uint16_t length);
+
+void WCDLI_closeResponse (void);
+void WCDLI_closeResponse_ex (WCDLI_Context_t* ctx);
+
+/*!
+ * \}
+ */
+
+#if (WCDLI_TX_BUFFER_DIMENSION > 0)
+/*!
+ * \defgroup WCDLI_Tx WC&DLI TX ring APIs
+ * \{
+ *
+ * With WCDLI_TX_BUFFER_DIMENSION greater than zero, the output is copied into
+ * a ring and the writer returns immediately. The ring is drained by the TX
+ * interrupt: WCDLI_callbackTx() must be called from the interrupt handler.
+ * For a DMA drain, override WCDLI_txStart() and move the span returned by
+ * WCDLI_txPeek(), then call WCDLI_txRelease() at the end of the transfer.
+ * With libohiboard the ring is drained into WCDLI_ckeck(). On the POSIX host
+ * a thread emulates the interrupt, paced by WCDLI_HOST_BAUDRATE.
+ *
+ * \note The WCDLI_TXOVERFLOW_BLOCK policy must not be used from an interrupt
+ *       with priority higher than the TX interrupt, and the
+ *       WCDLI_TXOVERFLOW_DROP_OLDEST policy must not be used with a DMA drain.
+ */
+
+#if !defined (LIBOHIBOARD_VERSION)
+#if defined (__MCUXPRESSO)
+#if defined (__MCUXPRESSO_UART)
+void WCDLI_callbackTx (UART_Type* base, void* obj);
+#elif defined (__MCUXPRESSO_USART)
+void WCDLI_callbackTx (USART_Type* base, void* obj);
+#endif
+#elif defined (__NUECLIPSE)
+void WCDLI_callbackTx (UART_T* base, void* obj);
+#elif defined (__POSIX_HOST)
+void WCDLI_callbackTx (WCDLI_HostDevice_t* base, void* obj);
+#endif
+#endif
+
+/*!
+ * Start the drain of the TX ring. The default implementation enables the
+ * TX interrupt of the peripheral of the console.
+ *
+ * \param[in] ctx: The console with bytes to send.
+ */
+void WCDLI_txStart (WCDLI_Context_t* ctx);
+
+/*!
+ * \param[out] data: The first byte to send.
+ * \return The number of contiguous bytes to send.
+ */
+uint16_t WCDLI_txPeek (const uint8_t** data);
+uint16_t WCDLI_txPeek_ex (WCDLI_Context_t* ctx, const uint8_t** data);
+
+/*!
+ * \param[in] length: The number of bytes sent.
+ */
+void WCDLI_txRelease (uint16_t length);
+void WCDLI_txRelease_ex (WCDLI_Context_t* ctx, uint16_t length);
+
+/*!
+ * \param[in] policy: What to do when the TX ring is full.
+ */
+void WCDLI_setTxOverflowPolicy (WCDLI_TxOverflowPolicy_t policy);
+void WCDLI_setTxOverflowPolicy_ex (WCDLI_Context_t* ctx, WCDLI_TxOverflowPolicy_t policy);
+
+/*!
+ * \}
+ */
+#endif
+
+/*!
+ * \defgroup WCDLI_Command WC&DLI Command APIs
+ * \{
+ */
+
+/*!
+ *
+ */
+void WCDLI_printProjectVersion (void* app, int argc, const char* argv[]);
+
+/*!
+ * The command "status". The default implementation prints the health
+ * counters of the console, and "status reset" clears them.
+ */
+void WCDLI_printStatus (void* app, int argc, const char* argv[]);
+
+void WCDLI_save (void* app, int argc, const char* argv[]);
 
 /*!
  *
  */
 void WCDLI_ckeck (void);
 
+/*!
+ * Process the incoming bytes of a console: the commands print on the
+ * console that runs them. A line can hold many commands separated by ';'.
+ * After the command "batch", the lines up to "end" run without prompts,
+ * WCDLI_BATCH_LINES_PER_CHECK at every call, and "end" prints the number
+ * of commands and of errors.
+ *
+ * \param[in] ctx: The context of the console.
+ */
+void WCDLI_ckeck_ex (WCDLI_Context_t* ctx);
+
+/*!
+ * Valid only inside a command callback, and from the macros printing its
+ * answers: the command running on another console than the main one finds
+ * its console here.
+ *
+ * \return The console running the command, NULL outside of a command.
+ */
+WCDLI_Context_t* WCDLI_currentContext (void);
+
+/*!
+ * The clock of the commands profile and of the TX blocked time: the cycle
+ * counter of the DWT on the Cortex-M that have it, the monotonic clock in ns
+ * on the host, the system tick otherwise. Only the differences are used, so
+ * it can wrap. It is weak, to be replaced by a faster counter.
+ */
+uint32_t WCDLI_getCycles (void);
+
+/*!
+ * \param[in] ctx: The context of the console.
+ * \return The health counters of the console.
+ */
+const WCDLI_Counters_t* WCDLI_getCounters_ex (WCDLI_Context_t* ctx);
+const WCDLI_Counters_t* WCDLI_getCounters (void);
+
+/*!
+ * Clear the health counters of the console.
+ *
+ * \param[in] ctx: The context of the console.
+ */
+void WCDLI_resetCounters_ex (WCDLI_Context_t* ctx);
+void WCDLI_resetCounters (void);
+
 /*!
  *
  * \param[in]        name:
@@ -168,6 +658,80 @@ WCDLI_Error_t WCDLI_addCommandByParam (const char* name,
                                        const char* description,
                                        WCDLI_CommandCallback_t callback);
 
+/*!
+ * Add a command whose callback receives the arguments by pointer, without
+ * copies.
+ *
+ * \param[in]        name:
+ * \param[in] description:
+ * \param[in]    callback:
+ * \return
+ */
+WCDLI_Error_t WCDLI_addCommandByArgv (const char* name,
+                                      const char* description,
+                                      WCDLI_CommandArgvCallback_t callback);
+
+/*!
+ * Add a command whose arguments are parsed and checked against a schema in
+ * one pass: the callback receives typed values, and a wrong line prints the
+ * error and the usage without calling it.
+ *
+ *     static const char* const modes[] = {"auto", "manual", NULL};
+ *     static const WCDLI_ArgSchema_t args[] =
+ *     {
+ *         WCDLI_ARG_UINT("speed",0,0,3000),
+ *         WCDLI_ARG_ENUM("mode",WCDLI_ARGFLAG_OPTIONAL,modes),
+ *         WCDLI_ARG_FLOAT("ramp",WCDLI_ARGFLAG_OPTION,0,0),
+ *     };
+ *     static const WCDLI_CommandSchema_t schema = {args, 3, setSpeed};
+ *
+ * accepts "set 1500", "set 1500 manual --ramp=2.5" or "set --ramp=1 10".
+ *
+ * \param[in]        name:
+ * \param[in] description:
+ * \param[in]      schema: It must live for the whole program.
+ * \return
+ */
+WCDLI_Error_t WCDLI_addCommandBySchema (const char* name,
+                                        const char* description,
+                                        const WCDLI_CommandSchema_t* schema);
+
+/*!
+ * Start the body of a resumable command. The local variables are not kept
+ * between two calls: keep the state into static or app variables.
+ */
+#define WCDLI_RUN_BEGIN(RUN)                     switch ((RUN)->step) { case 0:
+
+/*!
+ * Return to WCDLI_ckeck(), the next call continues from here.
+ */
+#define WCDLI_RUN_YIELD(RUN)                               \
+    do {                                                   \
+        (RUN)->step = __LINE__;                            \
+        return WCDLI_COMMANDSTATE_RUNNING;                 \
+        case __LINE__:;                                    \
+    } while (0)
+
+/*!
+ * End the body of a resumable command.
+ */
+#define WCDLI_RUN_END(RUN)                       } (RUN)->step = 0; return WCDLI_COMMANDSTATE_DONE
+
+/*!
+ * Add a command that can yield, to be continued by the next WCDLI_ckeck().
+ * While it runs the new lines wait, and Ctrl-C cancels it. The
+ * WCDLI_RUN_BEGIN(), WCDLI_RUN_YIELD() and WCDLI_RUN_END() macros write the
+ * callback as a protothread.
+ *
+ * \param[in]        name:
+ * \param[in] description:
+ * \param[in]    callback:
+ * \return
+ */
+WCDLI_Error_t WCDLI_addResumableCommand (const char* name,
+                                         const char* description,
+                                         WCDLI_CommandResumableCallback_t callback);
+
 /*!
  *
  *
@@ -189,12 +753,55 @@ WCDLI_Error_t WCDLI_addAppByParam (const char* name,
                                    void* app,
                                    WCDLI_CommandCallback_t callback);
 
+/*!
+ * Add an app whose callback receives the arguments by pointer, without
+ * copies.
+ *
+ * \param[in]        name:
+ * \param[in] description:
+ * \param[in]         app:
+ * \param[in]    callback:
+ * \return
+ */
+WCDLI_Error_t WCDLI_addAppByArgv (const char* name,
+                                  const char* description,
+                                  void* app,
+                                  WCDLI_CommandArgvCallback_t callback);
+
+/*!
+ * Add an app whose arguments are parsed against a schema, as
+ * WCDLI_addCommandBySchema().
+ *
+ * \param[in]        name:
+ * \param[in] description:
+ * \param[in]         app:
+ * \param[in]      schema: It must live for the whole program.
+ * \return
+ */
+WCDLI_Error_t WCDLI_addAppBySchema (const char* name,
+                                    const char* description,
+                                    void* app,
+                                    const WCDLI_CommandSchema_t* schema);
+
 /*!
  * \param[in] app:
  * \return
  */
 WCDLI_Error_t WCDLI_addApp (WCDLI_Command_t* app);
 
+/*!
+ * The ID of a command in binary mode. The remote terminal enters the binary
+ * mode with the line "###", and waits the answer "Binary mode" before
+ * sending packets; the packet with ID WCDLI_BINARY_ID_EXIT goes back to the
+ * command mode. A command answers in binary mode when it has a
+ * binaryCallback, set into its WCDLI_Command_t.
+ *
+ * \param[in] name: The command or app name.
+ * \param[out]  id:
+ * \return WCDLI_ERROR_WRONG_PARAMS when the name is not registered.
+ */
+WCDLI_Error_t WCDLI_getCommandId (const char* name, uint16_t* id);
+
 /*!
  *
  * \param[in]        name:
@@ -211,24 +818,264 @@ void WCDLI_helpLine (const char* name, const char* description);
  * \{
  */
 
+/*!
+ * The time of the log messages and of the deferred messages, a free running
+ * 32 bit counter: the deltas are right across its wrap. The default
+ * implementation returns the microseconds of CLOCK_MONOTONIC on the host,
+ * the system tick with libohiboard, zero otherwise.
+ */
+uint32_t WCDLI_getTimestamp (void);
+
 /*!
  *
  * \param[in] level:
  * \param[in]  str:
  */
 void WCDLI_debug (WCDLI_MessageLevel_t level, const char* str);
+void WCDLI_debug_ex (WCDLI_Context_t* ctx, WCDLI_MessageLevel_t level, const char* str);
 
 /*!
+ * Print a formatted message. The built-in formatter writes straight into
+ * the output, so a printed message is never truncated; a message of the log
+ * queue is still limited to WCDLI_MAX_CHARS_PER_LINE chars.
+ * It supports %d %i %u %x %X %s %c %p %f and %%, the flags - 0 + # and
+ * space, width and precision, also as *, and the length modifiers hh h l ll
+ * z. %e and %g are printed as %f, rounded half up with at most 9 decimals.
  *
  * \param[in]  level:
  * \param[in] format:
  */
 void WCDLI_debugByFormat (WCDLI_MessageLevel_t level, const char* format, ...);
+void WCDLI_debugByFormat_ex (WCDLI_Context_t* ctx, WCDLI_MessageLevel_t level, const char* format, ...);
+
+#if (WCDLI_LOG_QUEUE_SLOTS > 0)
+/*!
+ * With WCDLI_LOG_QUEUE_SLOTS greater than zero, the messages with a level
+ * other than WCDLI_MESSAGELEVEL_NONE are formatted into a slot of the log
+ * queue of the console, and printed whole by WCDLI_ckeck(): tasks and
+ * interrupts can log at the same time without waiting for the UART and
+ * without mixing their lines. When the queue is full the message is lost and
+ * counted. The answers of the commands are still written by the caller.
+ *
+ * Print the queued messages. It is called by WCDLI_ckeck() of the console:
+ * when it is called elsewhere, it must be called by one task only.
+ *
+ * \param[in] maxRecords: Max number of messages to print.
+ * \return The number of messages printed.
+ */
+uint16_t WCDLI_processLog (uint16_t maxRecords);
+uint16_t WCDLI_processLog_ex (WCDLI_Context_t* ctx, uint16_t maxRecords);
+#endif
+
+#if (WCDLI_DEFERRED_BUFFER_DIMENSION > 0)
+/*!
+ * Record a message without formatting it: the caller stores the address of
+ * the format string, the level, the timestamp and the argument words into a
+ * ring. The message is formatted later by WCDLI_processDeferred(), or by the
+ * host decoder (tools/wcdli-decoder.c) with WCDLI_DEFERRED_OUTPUT_BINARY.
+ *
+ * \note The arguments must be integer words (%d, %u, %x, %c): strings and
+ *       floating point values are not supported. Use WCDLI_DEBUG_DEFERRED(),
+ *       which converts every argument to uint32_t and fails to build when
+ *       one is wider than 32 bit.
+ *
+ * \param[in]  level:
+ * \param[in] format: The format string, it must live for the whole program.
+ * \param[in]   argc: The number of argument words.
+ */
+void WCDLI_debugDeferred (WCDLI_MessageLevel_t level, const char* format, uint8_t argc, ...);
+
+/*!
+ * Format and print the recorded messages, or send them as binary records,
+ * on the first initialized console. It is called by WCDLI_ckeck() of that
+ * console, and it can be called in idle time.
+ *
+ * \param[in] maxRecords: Max number of messages to process.
+ * \return The number of messages processed.
+ */
+uint16_t WCDLI_processDeferred (uint16_t maxRecords);
+
+/*!
+ * \param[in] output: Where the deferred messages go.
+ */
+void WCDLI_setDeferredOutput (WCDLI_DeferredOutput_t output);
+
+#define WCDLI_NARGS(...)                         WCDLI_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define WCDLI_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+/*!
+ * An argument word of a deferred message: the build fails when the argument
+ * is wider than 32 bit, as a 64 bit value, a double or a pointer of a 64 bit
+ * host.
+ */
+#define WCDLI_DEFERRED_WORD(ARG)                 \
+    ((uint32_t)(ARG) + (0u * sizeof(char[(sizeof(ARG) <= 4u) ? 1 : -1])))
+
+#define WCDLI_DEFERRED_WORDS_0(...)
+#define WCDLI_DEFERRED_WORDS_1(A)                , WCDLI_DEFERRED_WORD(A)
+#define WCDLI_DEFERRED_WORDS_2(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_1(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_3(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_2(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_4(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_3(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_5(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_4(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_6(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_5(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_7(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_6(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_8(A,...)            , WCDLI_DEFERRED_WORD(A) WCDLI_DEFERRED_WORDS_7(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS_(N,...)             WCDLI_DEFERRED_WORDS_##N(__VA_ARGS__)
+#define WCDLI_DEFERRED_WORDS(N,...)              WCDLI_DEFERRED_WORDS_(N, ##__VA_ARGS__)
+
+#define WCDLI_DEBUG_DEFERRED(LEVEL,FORMAT,...)                                 \
+    do {                                                                       \
+        if (WCDLI_IS_LEVEL_ENABLED(LEVEL))                                     \
+            WCDLI_debugDeferred(LEVEL,FORMAT,WCDLI_NARGS(__VA_ARGS__)          \
+                WCDLI_DEFERRED_WORDS(WCDLI_NARGS(__VA_ARGS__), ##__VA_ARGS__)); \
+    } while (0)
+#endif
 
 /*!
  * \}
  */
 
+/*!
+ * The debug level of WCDLI_mainContext: messages with a greater level are
+ * not printed.
+ */
+#define WCDLI_debugLevel                         (WCDLI_mainContext->debugLevel)
+
+/*!
+ * TRUE when a message of the level must be printed. The test is inlined
+ * into the caller, before any call or argument evaluation, and a constant
+ * level above WCDLI_COMPILE_MESSAGE_LEVEL folds to FALSE.
+ */
+#define WCDLI_IS_LEVEL_ENABLED(LEVEL)                      \
+    (((LEVEL) <= WCDLI_COMPILE_MESSAGE_LEVEL) && ((LEVEL) <= WCDLI_debugLevel))
+
+#define WCDLI_LOG(LEVEL,...)                               \
+    do {                                                   \
+        if (WCDLI_IS_LEVEL_ENABLED(LEVEL))                 \
+            WCDLI_debugByFormat(LEVEL,__VA_ARGS__);        \
+    } while (0)
+
+#define WCDLI_LOG_STRING(LEVEL,MESSAGE)                    \
+    do {                                                   \
+        if (WCDLI_IS_LEVEL_ENABLED(LEVEL))                 \
+            WCDLI_debug(LEVEL,MESSAGE);                    \
+    } while (0)
+
+#define WCDLI_LOG_DISABLED(...)                  do {} while (0)
+
+/*!
+ * Level-specific messages: the levels greater than
+ * WCDLI_COMPILE_MESSAGE_LEVEL expand to nothing.
+ */
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 1)
+#define WCDLI_LOG_FATAL(...)                     WCDLI_LOG(WCDLI_MESSAGELEVEL_FATAL,__VA_ARGS__)
+#else
+#define WCDLI_LOG_FATAL(...)                     WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 2)
+#define WCDLI_LOG_ERROR(...)                     WCDLI_LOG(WCDLI_MESSAGELEVEL_DANGER,__VA_ARGS__)
+#else
+#define WCDLI_LOG_ERROR(...)                     WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 3)
+#define WCDLI_LOG_WARNING(...)                   WCDLI_LOG(WCDLI_MESSAGELEVEL_WARNING,__VA_ARGS__)
+#else
+#define WCDLI_LOG_WARNING(...)                   WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 4)
+#define WCDLI_LOG_INFO(...)                      WCDLI_LOG(WCDLI_MESSAGELEVEL_INFO,__VA_ARGS__)
+#else
+#define WCDLI_LOG_INFO(...)                      WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 5)
+#define WCDLI_LOG_DEBUG(...)                     WCDLI_LOG(WCDLI_MESSAGELEVEL_DEBUG,__VA_ARGS__)
+#else
+#define WCDLI_LOG_DEBUG(...)                     WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+/*!
+ * Register a module, or tag, with its own debug level. The level is changed
+ * with WCDLI_setModuleLevel() or with the debug command.
+ *
+ * \param[in]    name: The module name, it must live for the whole program.
+ * \param[in]   level: The initial debug level.
+ * \param[out] module: The module identifier.
+ * \return WCDLI_ERROR_ADD_MODULE_FAIL when the table is full or the name is
+ *         just registered.
+ */
+WCDLI_Error_t WCDLI_addModule (const char* name,
+                               WCDLI_MessageLevel_t level,
+                               WCDLI_Module_t* module);
+
+/*!
+ * \param[in] module:
+ * \param[in]  level:
+ */
+void WCDLI_setModuleLevel (WCDLI_Module_t module, WCDLI_MessageLevel_t level);
+
+/*!
+ * Print a message tagged with the module name, filtered by the module level.
+ *
+ * \param[in] module:
+ * \param[in]  level:
+ * \param[in] format:
+ */
+void WCDLI_debugModuleByFormat (WCDLI_Module_t module,
+                                WCDLI_MessageLevel_t level,
+                                const char* format, ...);
+
+/*!
+ * Debug level of every module, indexed by the module identifier.
+ */
+extern uint8_t WCDLI_moduleLevels[WCDLI_MAX_MODULES];
+
+/*!
+ * TRUE when a message of the module and level must be printed: a single
+ * indexed load, inlined into the caller.
+ */
+#define WCDLI_IS_MODULE_LEVEL_ENABLED(MODULE,LEVEL)        \
+    (((LEVEL) <= WCDLI_COMPILE_MESSAGE_LEVEL) && ((LEVEL) <= WCDLI_moduleLevels[(MODULE)]))
+
+#define WCDLI_LOG_MODULE(MODULE,LEVEL,...)                   \
+    do {                                                     \
+        if (WCDLI_IS_MODULE_LEVEL_ENABLED(MODULE,LEVEL))     \
+            WCDLI_debugModuleByFormat(MODULE,LEVEL,__VA_ARGS__); \
+    } while (0)
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 1)
+#define WCDLI_LOG_MODULE_FATAL(MODULE,...)       WCDLI_LOG_MODULE(MODULE,WCDLI_MESSAGELEVEL_FATAL,__VA_ARGS__)
+#else
+#define WCDLI_LOG_MODULE_FATAL(MODULE,...)       WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 2)
+#define WCDLI_LOG_MODULE_ERROR(MODULE,...)       WCDLI_LOG_MODULE(MODULE,WCDLI_MESSAGELEVEL_DANGER,__VA_ARGS__)
+#else
+#define WCDLI_LOG_MODULE_ERROR(MODULE,...)       WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 3)
+#define WCDLI_LOG_MODULE_WARNING(MODULE,...)     WCDLI_LOG_MODULE(MODULE,WCDLI_MESSAGELEVEL_WARNING,__VA_ARGS__)
+#else
+#define WCDLI_LOG_MODULE_WARNING(MODULE,...)     WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 4)
+#define WCDLI_LOG_MODULE_INFO(MODULE,...)        WCDLI_LOG_MODULE(MODULE,WCDLI_MESSAGELEVEL_INFO,__VA_ARGS__)
+#else
+#define WCDLI_LOG_MODULE_INFO(MODULE,...)        WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if (WCDLI_COMPILE_MESSAGE_LEVEL >= 5)
+#define WCDLI_LOG_MODULE_DEBUG(MODULE,...)       WCDLI_LOG_MODULE(MODULE,WCDLI_MESSAGELEVEL_DEBUG,__VA_ARGS__)
+#else
+#define WCDLI_LOG_MODULE_DEBUG(MODULE,...)       WCDLI_LOG_DISABLED(__VA_ARGS__)
+#endif
+
 /*!
  * \defgroup WCDLI_Utility WC&DLI Utility functions
  * \{
@@ -244,19 +1091,19 @@ void WCDLI_debugByFormat (WCDLI_MessageLevel_t level, const char* format, ...);
         WCDLI_debug(LEVELSTRING,MESSAGE);        \
     } while (0)
 
-#define WCDLI_PRINT_INFO_MESSAGE(MESSAGE)            \
-    do {                                             \
-        WCDLI_debug(WCDLI_MESSAGELEVEL_INFO,MESSAGE);\
+#define WCDLI_PRINT_INFO_MESSAGE(MESSAGE)                    \
+    do {                                                     \
+        WCDLI_LOG_STRING(WCDLI_MESSAGELEVEL_INFO,MESSAGE);   \
     } while (0)
 
-#define WCDLI_PRINT_WARNING_MESSAGE(MESSAGE)            \
-    do {                                                \
-        WCDLI_debug(WCDLI_MESSAGELEVEL_WARNING,MESSAGE);\
+#define WCDLI_PRINT_WARNING_MESSAGE(MESSAGE)                 \
+    do {                                                     \
+        WCDLI_LOG_STRING(WCDLI_MESSAGELEVEL_WARNING,MESSAGE);\
     } while (0)
 
-#define WCDLI_PRINT_ERROR_MESSAGE(MESSAGE)             \
-    do {                                               \
-        WCDLI_debug(WCDLI_MESSAGELEVEL_DANGER,MESSAGE);\
+#define WCDLI_PRINT_ERROR_MESSAGE(MESSAGE)                   \
+    do {                                                     \
+        WCDLI_LOG_STRING(WCDLI_MESSAGELEVEL_DANGER,MESSAGE); \
     } while (0)
 
 /*!
@@ -274,6 +1121,11 @@ void WCDLI_debugByFormat (WCDLI_MessageLevel_t level, const char* format, ...);
  */
 #define WCDLI_PRINT_NO_COMMAND()                 WCDLI_PRINT_CMD_MESSAGE("Error: Command not found!")
 
+/*!
+ *
+ */
+#define WCDLI_PRINT_AMBIGUOUS_COMMAND()          WCDLI_PRINT_CMD_MESSAGE("Error: Ambiguous command!")
+
 /*!
  *
  */
@@ -284,6 +1136,16 @@ void WCDLI_debugByFormat (WCDLI_MessageLevel_t level, const char* format, ...);
  */
 #define WCDLI_PRINT_COMMAND_NOT_IMPLEMENTED()    WCDLI_PRINT_CMD_MESSAGE("Error: Command not implemented!")
 
+/*!
+ *
+ */
+#define WCDLI_PRINT_BUSY()                       WCDLI_PRINT_CMD_MESSAGE("Busy: Command running, Ctrl-C to cancel!")
+
+/*!
+ *
+ */
+#define WCDLI_PRINT_CANCELLED()                  WCDLI_PRINT_CMD_MESSAGE("Command cancelled!")
+
 /*!
  * \}
  */